@@ -0,0 +1,131 @@
+/*****************************************************************************
+  Author: Charlie Murphy
+  Email:  tcm3@cs.princeton.edu
+
+  Date:   October 18, 2026
+
+  Description: Solving under assumptions. Bursts of queries on the same
+    instance that differ only in a few forced or forbidden mappings share
+    the filtered root state of one Embedding: each query applies its
+    assumptions on top of it as base decisions, searches, and unwinds every
+    removal afterwards, so it pays only for its own propagation and search.
+ *****************************************************************************/
+
+#include <vector>
+#include <stack>
+#include "definitions.h"
+#include "graph.h"
+#include "embedding.h"
+#include "match_embeds.h"
+#include "selection.h"
+#include "stats.h"
+#include "limits.h"
+
+#ifndef CM_ASSUMPTIONS_H
+#define CM_ASSUMPTIONS_H
+
+/* u |-> v is forced, or ruled out if forbidden, for one query (in the ids of
+   the structures given to the Embedding, even when it reorders them) */
+struct Assumption {
+  Assumption(size_t _u = 0, size_t _v = 0, bool _forbidden = false) : u(_u), v(_v), forbidden(_forbidden) {}
+  size_t u;
+  size_t v;
+  bool forbidden;
+};
+
+/* Apply a as the decision d on top of the stack; false if it is inconsistent */
+template <class Element, class Predicate, class Signature>
+bool assume(Embedding<Element, Predicate, Signature>& e, decision& d, const Assumption& a) {
+  Graph& u_graph = e.get_universe_graph();
+  if (!a.forbidden) {
+    if (!u_graph.has_edge(a.u, a.v)) return false;
+    e.decide(d);
+    return e.is_valid();
+  }
+  const std::vector<Graph::Edge>& adj = u_graph.uAdj(a.u);
+  size_t pos;
+  for (pos = 0; pos < adj.size() && adj[pos].vertex != a.v; ++pos);
+  if (pos == adj.size()) return true;
+  u_graph.remove_edge(a.u, pos);
+  d.remove_u.emplace_back(a.u, a.v);
+  if (adj.empty()) return false;
+  if (adj.size() == 1 && !e.commit_edge(a.u, adj[0].vertex, d.remove_u)) return false;
+  e.set_at_root(false);
+  return e.filter(d.remove_u, d.remove_p) && e.is_valid();
+}
+
+/* Solve e under the assumptions with the given indices and restore the
+   state it started from. applied is the number of them applied, the last
+   one failing if applying them was inconsistent. */
+template <class Element, class Predicate, class Signature>
+Search_result solve_assuming(Embedding<Element, Predicate, Signature>& e, const std::vector<Assumption>& assumptions,
+                             const std::vector<size_t>& active, SearchLimits& limits, SearchStats& stats, Var_selection sel,
+                             size_t& applied) {
+  std::stack<decision> decisions;
+  Search_result r = UNSAT;
+  bool consistent = true;
+  for (applied = 0; consistent && applied < active.size(); ++applied) {
+    const Assumption& given = assumptions[active[applied]];
+    Assumption a(e.local_u(given.u), e.local_v(given.v), given.forbidden);
+    decisions.emplace(a.u, a.v);
+    consistent = assume(e, decisions.top(), a);
+  }
+  if (consistent) {
+    r = search_propagated(e, limits, stats, sel, NULL, decisions, active.size());
+  }
+  for (; !decisions.empty(); decisions.pop()) {
+    e.add_back(decisions.top().remove_p, decisions.top().remove_u);
+  }
+  e.set_at_root(true);
+  return r;
+}
+
+/* Search for an embedding of e in which every assumption holds. The first
+   call filters e at the root and keeps a copy of that state (see
+   Embedding::keep_root); every call starts from it, restoring it if e was
+   searched or decided on in between by other means, and returns to it. e
+   must not have been searched before the first call unless it already kept
+   its root state (or has the incremental option).
+
+   If the result is UNSAT and core is given, it receives the indices of
+   assumptions that are inconsistent together: the ones applied until
+   propagation failed, or all of them if the search failed, shrunk by
+   dropping each one whose removal leaves the rest unsatisfiable (so that
+   no single one can be left out), unless a limit is hit first. It is
+   empty when e has no embedding at all. */
+template <class Element, class Predicate, class Signature>
+Search_result MatchEmbeds(Embedding<Element, Predicate, Signature>& e, const std::vector<Assumption>& assumptions, SearchLimits limits,
+                          SearchStats& stats, std::vector<size_t>* core = NULL, Var_selection sel = MIN_REMAINING_VALUES) {
+  if (core != NULL) core->clear();
+  limits = limits.started();
+  if (e.over_budget()) {
+    stats.stop_reason = MEMORY_LIMIT;
+    return UNKNOWN;
+  }
+  e.keep_root();
+  if (!e.at_root() && !propagate_root(e, &limits, &stats)) return stats.stop_reason != NOT_STOPPED ? UNKNOWN : UNSAT;
+  std::vector<size_t> active;
+  for (size_t i = 0; i < assumptions.size(); ++i) active.push_back(i);
+  size_t applied;
+  Search_result r = solve_assuming(e, assumptions, active, limits, stats, sel, applied);
+  if (r != UNSAT || core == NULL) return r;
+
+  active.resize(applied);
+  for (size_t i = 0; i < active.size(); ) {
+    std::vector<size_t> rest(active);
+    rest.erase(rest.begin() + i);
+    Search_result s = solve_assuming(e, assumptions, rest, limits, stats, sel, applied);
+    if (s == UNSAT) {
+      rest.resize(applied);
+      active.swap(rest);
+    } else if (s == SAT) {
+      ++i;
+    } else {
+      break;
+    }
+  }
+  core->swap(active);
+  return r;
+}
+
+#endif
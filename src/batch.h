@@ -0,0 +1,188 @@
+/*****************************************************************************
+  Author: Charlie Murphy
+  Email:  tcm3@cs.princeton.edu
+
+  Date:   October 18, 2026
+
+  Description: Matching a batch of patterns against one target. Patterns
+    run against the same target tend to share element signatures, and
+    propositions of the same relation over elements of equal signatures.
+    The candidates of an element depend only on its signature, and those
+    of a proposition only on its relation and the signatures of its
+    arguments, so each distinct one is computed once for the whole batch.
+    Every pattern then builds its Embedding from them and is searched on a
+    thread pool.
+ *****************************************************************************/
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include "structure.h"
+#include "target.h"
+#include "embedding.h"
+#include "match_embeds.h"
+#include "thread_pool.h"
+
+#ifndef CM_BATCH_H
+#define CM_BATCH_H
+
+/* Candidates in one target shared by the patterns added to it */
+template <class Element, class Predicate, class Signature>
+class SharedCandidates {
+  public:
+    typedef Structure<Element, Predicate, Signature> Str;
+    typedef Target<Element, Predicate, Signature> Tgt;
+
+    /* Candidates for embeddings or, with homomorphism, homomorphisms; those of
+       propositions only with propositions set (they are not needed when the
+       predicate graph is not built) */
+    SharedCandidates(std::shared_ptr<const Tgt> target, bool homomorphism, bool propositions) :
+      target_(target), homomorphism_(homomorphism), propositions_(propositions) {}
+
+    /* Register the signatures and propositions of a; call compute afterwards */
+    void add(const Str& a) {
+      std::vector<size_t> ids(a.universe_size());
+      for (size_t u = 0; u < ids.size(); ++u) {
+        ids[u] = signature_ids_.insert(std::make_pair(a.get_signature(u), signature_ids_.size())).first->second;
+      }
+      if (!propositions_) return;
+      const PropTable& props = a.propositions();
+      for (size_t p = 0; p < props.size(); ++p) {
+        tuple_ids_.insert(std::make_pair(tuple_key(props, p, ids), tuple_ids_.size()));
+      }
+    }
+
+    /* Compute the candidates of everything added since the last call */
+    void compute() {
+      std::vector<const Signature*> signatures(signature_ids_.size());
+      for (typename std::map<Signature, size_t>::const_iterator it = signature_ids_.begin(); it != signature_ids_.end(); ++it) {
+        signatures[it->second] = &it->first;
+      }
+      size_t first = elements_.size();
+      elements_.resize(signatures.size());
+      #pragma omp parallel for schedule(dynamic)
+      for (size_t i = first; i < signatures.size(); ++i) {
+        elements_[i] = target_->candidates(*signatures[i], homomorphism_);
+      }
+
+      std::vector<const std::vector<size_t>*> keys(tuple_ids_.size());
+      for (std::map<std::vector<size_t>, size_t>::const_iterator it = tuple_ids_.begin(); it != tuple_ids_.end(); ++it) {
+        keys[it->second] = &it->first;
+      }
+      first = tuples_.size();
+      tuples_.resize(keys.size());
+      #pragma omp parallel for schedule(dynamic)
+      for (size_t i = first; i < keys.size(); ++i) {
+        fill_tuple(*keys[i], tuples_[i]);
+      }
+    }
+
+    /* The candidate sets of a, which must have been added and computed; they
+       point into this object, which must outlive their use */
+    CandidateSets sets(const Str& a) const {
+      CandidateSets c;
+      std::vector<size_t> ids(a.universe_size());
+      for (size_t u = 0; u < ids.size(); ++u) {
+        ids[u] = signature_ids_.find(a.get_signature(u))->second;
+        c.elements.push_back(&elements_[ids[u]]);
+      }
+      if (!propositions_) return c;
+      const PropTable& props = a.propositions();
+      for (size_t p = 0; p < props.size(); ++p) {
+        c.propositions.push_back(&tuples_[tuple_ids_.find(tuple_key(props, p, ids))->second]);
+      }
+      return c;
+    }
+
+    size_t num_signatures() const { return elements_.size(); }
+    size_t num_tuples() const { return tuples_.size(); }
+
+  private:
+    std::shared_ptr<const Tgt> target_;
+    bool homomorphism_;
+    bool propositions_;
+    std::map<Signature, size_t> signature_ids_;
+    /* (relation, signature ids of the arguments) of the propositions */
+    std::map<std::vector<size_t>, size_t> tuple_ids_;
+    std::vector<std::vector<size_t>> elements_;   /* candidates of each signature */
+    std::vector<std::vector<size_t>> tuples_;     /* candidates of each proposition key */
+
+    static std::vector<size_t> tuple_key(const PropTable& props, size_t p, const std::vector<size_t>& ids) {
+      std::vector<size_t> key(1, props.pred(p));
+      const size_t* vars = props.vars(p);
+      for (size_t k = 0; k < props.arity(p); ++k) key.push_back(ids[vars[k]]);
+      return key;
+    }
+
+    /* The propositions of b of the relation in key whose arguments are
+       candidates of the signatures in key */
+    void fill_tuple(const std::vector<size_t>& key, std::vector<size_t>& row) const {
+      const PropTable& v_props = target_->props();
+      size_t arity = key.size() - 1;
+      const std::vector<size_t>& candidates = target_->pred_props(key[0]);
+      for (size_t c = 0; c < candidates.size(); ++c) {
+        size_t q = candidates[c];
+        const size_t* v_vars = v_props.vars(q);
+        bool mem(arity == v_props.arity(q));
+        for (size_t k = 0; mem && k < arity; ++k) {
+          const std::vector<size_t>& vs = elements_[key[k + 1]];
+          mem = std::binary_search(vs.begin(), vs.end(), v_vars[k]);
+        }
+        if (mem) row.push_back(q);
+      }
+    }
+};
+
+/* Sharing achieved by a batch */
+struct BatchStats {
+  BatchStats() : patterns(0), elements(0), signatures(0), propositions(0), tuples(0) {}
+  size_t patterns;
+  size_t elements;       /* of the patterns */
+  size_t signatures;     /* distinct among them: candidate sets computed */
+  size_t propositions;   /* of the patterns */
+  size_t tuples;         /* distinct (relation, argument signatures): proposition candidates computed */
+};
+
+/* Search for an embedding of every pattern in b on threads threads, computing
+   the candidates once for the batch (see SharedCandidates). The i-th result
+   is for patterns[i]. The limits apply to each search on its own, except
+   that a deadline (SearchLimits::within) is shared by the whole batch; a
+   budget (SearchLimits::per_search) starts when each search does. The
+   statistics of the i-th search (why it stopped, for UNKNOWN) go to
+   search_stats[i] if given. */
+template <class Element, class Predicate, class Signature>
+std::vector<Search_result> MatchEmbedsBatch(const std::vector<const Structure<Element, Predicate, Signature>*>& patterns,
+                                            std::shared_ptr<const Target<Element, Predicate, Signature>> b, size_t threads = 1,
+                                            const EmbeddingOptions& options = EmbeddingOptions(),
+                                            const SearchLimits& limits = SearchLimits(), BatchStats* stats = NULL,
+                                            std::vector<SearchStats>* search_stats = NULL) {
+  SharedCandidates<Element, Predicate, Signature> shared(b, options.homomorphism, !options.lazy_predicates);
+  for (size_t i = 0; i < patterns.size(); ++i) shared.add(*patterns[i]);
+  shared.compute();
+  if (stats != NULL) {
+    stats->patterns = patterns.size();
+    for (size_t i = 0; i < patterns.size(); ++i) {
+      stats->elements += patterns[i]->universe_size();
+      stats->propositions += patterns[i]->propositions().size();
+    }
+    stats->signatures = shared.num_signatures();
+    stats->tuples = shared.num_tuples();
+  }
+
+  std::vector<Search_result> results(patterns.size(), UNKNOWN);
+  if (search_stats != NULL) search_stats->assign(patterns.size(), SearchStats());
+  ThreadPool pool(std::min(threads, patterns.size()));
+  for (size_t i = 0; i < patterns.size(); ++i) {
+    pool.submit([&patterns, &b, &options, &limits, &shared, &results, search_stats, i]() {
+      CandidateSets sets = shared.sets(*patterns[i]);
+      Embedding<Element, Predicate, Signature> e(*patterns[i], b, options, &sets);
+      SearchStats own;
+      results[i] = MatchEmbeds(e, limits, search_stats != NULL ? (*search_stats)[i] : own);
+    });
+  }
+  pool.wait();
+  return results;
+}
+
+#endif
@@ -0,0 +1,382 @@
+/*******************************************************************
+    Author: Charlie Murphy
+    Email:  tcm3@cs.princeton.edu
+
+    Date:   October 18, 2026
+
+    Description: Benchmark driver. Runs generated instances (planted
+    SAT, near miss UNSAT, graph only and high arity), or the instances
+    of a benchmark suite directory, under every variable selection
+    heuristic, timing each stage of the pipeline, and writes or
+    compares against a baseline file.
+
+    A suite directory either lists its instances in instances.txt, one
+    "pattern target" pair of paths (relative to the directory) per line,
+    or holds one instance per subdirectory as files named pattern and
+    target (with any extension), as in the LAD and VF2 collections.
+
+    Baseline files have one line per (case, heuristic) run:
+
+      case heuristic result decisions backtracks signatures fill_u_graph
+      fill_p_graph filter search total
+
+    with times in milliseconds. Lines starting with # are comments.
+ *******************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <cctype>
+#include <algorithm>
+#include <dirent.h>
+#include "structure.h"
+#include "embedding.h"
+#include "signature.h"
+#include "selection.h"
+#include "match_embeds.h"
+#include "generators.h"
+#include "stats.h"
+#include "limits.h"
+#include "formats.h"
+
+using namespace std;
+
+typedef Structure<string, string, MultiSetSignature> Str;
+typedef InstanceGenerator<MultiSetSignature> Generator;
+
+/* An instance: embed a into b. Suite instances are read from their files
+   when they are run. */
+struct BenchCase {
+  string name;
+  Str a;
+  Str b;
+  string pattern_file;
+  string target_file;
+};
+
+/* Measurements of one run */
+struct BenchResult {
+  BenchResult() : decisions(0), backtracks(0) {
+    for (size_t i = 0; i < 5; ++i) ms[i] = 0;
+    total = 0;
+  }
+  string result;
+  size_t decisions;
+  size_t backtracks;
+  double ms[5];   /* signatures, fill_u_graph, fill_p_graph, filter, search */
+  double total;
+};
+
+static const char* heuristic_names[] = {
+  "min_remaining_values", "max_remaining_values", "min_conflicts", "max_conflicts",
+  "min_conflict_history", "max_conflict_history", "first_var", "weighted_random_var",
+  "uniform_random_var",
+};
+static const size_t NUM_HEURISTICS = sizeof(heuristic_names) / sizeof(heuristic_names[0]);
+
+/* x, but no less than min */
+static size_t at_least(size_t x, size_t min) { return x < min ? min : x; }
+
+/* The benchmark instances; scale multiplies their size, down to a few
+   elements for each structure */
+vector<BenchCase> make_cases(double scale, uint64_t seed) {
+  Generator gen(seed);
+  vector<BenchCase> cases;
+  size_t n = at_least((size_t) (200 * scale), 8);
+
+  vector<RelationSpec> rels;
+  rels.push_back(RelationSpec("r", 2, 6 * n));
+  rels.push_back(RelationSpec("s", 3, 3 * n / 2));
+  BenchCase planted;
+  planted.name = "planted";
+  planted.b = gen.random_structure(n, rels);
+  planted.a = gen.planted_pattern(planted.b, at_least(n / 6, 3), 0.8);
+  cases.push_back(planted);
+
+  BenchCase near_miss;
+  near_miss.name = "near_miss";
+  near_miss.b = planted.b;
+  near_miss.a = gen.planted_pattern(near_miss.b, at_least(n / 8, 3), 1.0);
+  gen.perturb(near_miss.a, rels, 4);
+  cases.push_back(near_miss);
+
+  vector<RelationSpec> edges;
+  edges.push_back(RelationSpec("e", 2, 0));
+  BenchCase graph_planted;
+  graph_planted.name = "graph_planted";
+  graph_planted.b = gen.random_graph(3 * n / 4, 0.08);
+  graph_planted.a = gen.planted_pattern(graph_planted.b, at_least(n / 10, 3), 1.0);
+  cases.push_back(graph_planted);
+
+  BenchCase graph_near_miss;
+  graph_near_miss.name = "graph_near_miss";
+  graph_near_miss.b = graph_planted.b;
+  graph_near_miss.a = gen.planted_pattern(graph_near_miss.b, at_least(n / 8, 3), 1.0);
+  gen.perturb(graph_near_miss.a, edges, 3, true);
+  cases.push_back(graph_near_miss);
+
+  BenchCase graph_random;
+  graph_random.name = "graph_random";
+  graph_random.b = graph_planted.b;
+  graph_random.a = gen.random_graph(at_least(n / 20, 3), 0.3, "a");
+  cases.push_back(graph_random);
+
+  vector<RelationSpec> wide;
+  wide.push_back(RelationSpec("t", 4, 2 * n));
+  wide.push_back(RelationSpec("w", 6, n));
+  BenchCase high_arity;
+  high_arity.name = "high_arity";
+  high_arity.b = gen.random_structure(n / 2, wide);
+  high_arity.a = gen.planted_pattern(high_arity.b, at_least(n / 4, 3), 1.0);
+  cases.push_back(high_arity);
+
+  BenchCase high_arity_miss;
+  high_arity_miss.name = "high_arity_near_miss";
+  high_arity_miss.b = high_arity.b;
+  high_arity_miss.a = gen.planted_pattern(high_arity_miss.b, at_least(n / 4, 3), 1.0);
+  gen.perturb(high_arity_miss.a, wide, 2);
+  cases.push_back(high_arity_miss);
+
+  return cases;
+}
+
+/* Base name of path without its extension */
+string stem(const string& path) {
+  size_t slash = path.find_last_of('/');
+  string name = slash == string::npos ? path : path.substr(slash + 1);
+  return name.substr(0, name.find('.'));
+}
+
+/* Add the instances below dir (named by their path relative to root) to cases */
+void find_suite_cases(const string& root, const string& dir, vector<BenchCase>& cases) {
+  DIR* d = opendir((root + "/" + dir).c_str());
+  if (d == NULL) return;
+  vector<string> entries;
+  struct dirent* ent;
+  while ((ent = readdir(d)) != NULL) {
+    string name(ent->d_name);
+    if (name != "." && name != "..") entries.push_back(name);
+  }
+  closedir(d);
+  sort(entries.begin(), entries.end());
+
+  BenchCase c;
+  c.name = dir.empty() ? "." : dir;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    string path = root + "/" + (dir.empty() ? "" : dir + "/") + entries[i];
+    if (stem(entries[i]) == "pattern") c.pattern_file = path;
+    if (stem(entries[i]) == "target") c.target_file = path;
+  }
+  if (!c.pattern_file.empty() && !c.target_file.empty()) cases.push_back(c);
+
+  for (size_t i = 0; i < entries.size(); ++i) {
+    string sub = dir.empty() ? entries[i] : dir + "/" + entries[i];
+    DIR* s = opendir((root + "/" + sub).c_str());
+    if (s != NULL) {
+      closedir(s);
+      find_suite_cases(root, sub, cases);
+    }
+  }
+}
+
+/* The instances of the suite in dir */
+vector<BenchCase> suite_cases(const string& dir) {
+  vector<BenchCase> cases;
+  ifstream list(dir + "/instances.txt");
+  if (!list) {
+    find_suite_cases(dir, "", cases);
+    return cases;
+  }
+  string line;
+  while (getline(list, line)) {
+    istringstream ls(line);
+    BenchCase c;
+    if (line.empty() || line[0] == '#' || !(ls >> c.pattern_file >> c.target_file)) continue;
+    c.name = c.pattern_file + "," + c.target_file;
+    c.pattern_file = dir + "/" + c.pattern_file;
+    c.target_file = dir + "/" + c.target_file;
+    cases.push_back(c);
+  }
+  return cases;
+}
+
+/* Read the structures of a suite instance (format as for read_structure) */
+bool load_case(BenchCase& c, const string& format) {
+  bool valid = true;
+  c.a = read_structure<MultiSetSignature>(c.pattern_file, format, valid);
+  if (valid) c.b = read_structure<MultiSetSignature>(c.target_file, format, valid);
+  return valid;
+}
+
+/* Solve c once with heuristic sel */
+BenchResult run(const BenchCase& c, Var_selection sel, size_t timeout_ms) {
+  BenchResult r;
+  solver_stats().clear();
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  Embedding<string, string, MultiSetSignature> emb(c.a, c.b);
+  SearchLimits limits;
+  if (timeout_ms != 0) limits = SearchLimits::within(chrono::milliseconds(timeout_ms));
+  SearchStats stats;
+  Search_result res = MatchEmbeds(emb, limits, stats, sel);
+  r.total = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+  const SolverStats& s = solver_stats();
+  r.result = res == SAT ? "True" : (res == UNSAT ? "False" : "Unknown");
+  r.decisions = stats.decisions;
+  r.backtracks = stats.backtracks;
+  r.ms[0] = 1000 * s.seconds[PHASE_SIGNATURES];
+  r.ms[1] = 1000 * s.seconds[PHASE_FILL_U_GRAPH];
+  r.ms[2] = 1000 * s.seconds[PHASE_FILL_P_GRAPH];
+  r.ms[3] = 1000 * s.seconds[PHASE_FILTER];
+  r.ms[4] = 1000 * s.seconds[PHASE_SEARCH];
+  return r;
+}
+
+void write_result(ostream& outs, const string& name, const string& heuristic, const BenchResult& r) {
+  outs << name << " " << heuristic << " " << r.result << " " << r.decisions << " " << r.backtracks;
+  for (size_t i = 0; i < 5; ++i) outs << " " << r.ms[i];
+  outs << " " << r.total << endl;
+}
+
+/* Read a baseline file into results keyed by "case heuristic" */
+bool read_baseline(const string& file_name, map<string, BenchResult>& results) {
+  ifstream ins(file_name);
+  if (!ins) return false;
+  string line;
+  while (getline(ins, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    istringstream ls(line);
+    string name, heuristic;
+    BenchResult r;
+    ls >> name >> heuristic >> r.result >> r.decisions >> r.backtracks;
+    for (size_t i = 0; i < 5; ++i) ls >> r.ms[i];
+    ls >> r.total;
+    if (!ls) return false;
+    results[name + " " + heuristic] = r;
+  }
+  return true;
+}
+
+void usage() {
+  cerr << "usage: match-bench [--scale x] [--seed n] [--repeat n] [--timeout ms] [--heuristic name]" << endl;
+  cerr << "                   [--suite dir [--format lad|labelled-lad|gfu|arg|vf|struct|bstruct]]" << endl;
+  cerr << "                   [--save baseline] [--compare baseline [--tolerance x]]" << endl;
+}
+
+int main(int argc, char ** argv) {
+  double scale = 1.0;
+  uint64_t seed = 1;
+  size_t repeat = 3;        /* runs per (case, heuristic); the fastest is kept */
+  size_t timeout_ms = 2000;
+  double tolerance = 0.25;  /* allowed relative slowdown against the baseline */
+  double slack_ms = 5;      /* and absolute slowdown, so tiny runs do not flag noise */
+  string only, save, compare, suite, format;
+  for (int i = 1; i < argc; ++i) {
+    string arg(argv[i]);
+    if (arg == "--scale" && i + 1 < argc) {
+      scale = atof(argv[++i]);
+    } else if (arg == "--seed" && i + 1 < argc) {
+      seed = strtoull(argv[++i], NULL, 10);
+    } else if (arg == "--repeat" && i + 1 < argc) {
+      repeat = strtoul(argv[++i], NULL, 10);
+    } else if (arg == "--timeout" && i + 1 < argc) {
+      timeout_ms = strtoul(argv[++i], NULL, 10);
+    } else if (arg == "--heuristic" && i + 1 < argc) {
+      only = argv[++i];
+    } else if (arg == "--suite" && i + 1 < argc) {
+      suite = argv[++i];
+    } else if (arg == "--format" && i + 1 < argc) {
+      format = argv[++i];
+    } else if (arg == "--save" && i + 1 < argc) {
+      save = argv[++i];
+    } else if (arg == "--compare" && i + 1 < argc) {
+      compare = argv[++i];
+    } else if (arg == "--tolerance" && i + 1 < argc) {
+      tolerance = atof(argv[++i]);
+    } else {
+      usage();
+      return 1;
+    }
+  }
+  if (repeat == 0) repeat = 1;
+
+  map<string, BenchResult> baseline;
+  if (!compare.empty() && !read_baseline(compare, baseline)) {
+    cerr << "Could not read baseline " << compare << endl;
+    return 1;
+  }
+
+  ostringstream results;
+  if (suite.empty()) {
+    results << "# match-bench scale " << scale << " seed " << seed << " repeat " << repeat << endl;
+  } else {
+    results << "# match-bench suite " << suite << " repeat " << repeat << endl;
+  }
+  results << "# case heuristic result decisions backtracks signatures fill_u_graph fill_p_graph filter search total" << endl;
+
+  vector<BenchCase> cases = suite.empty() ? make_cases(scale, seed) : suite_cases(suite);
+  if (!suite.empty() && cases.empty()) {
+    cerr << "No instances found in " << suite << endl;
+    return 1;
+  }
+  bool failed = false;
+  for (size_t c = 0; c < cases.size(); ++c) {
+    for (size_t i = 0; i < cases[c].name.size(); ++i) {
+      if (isspace((unsigned char) cases[c].name[i])) cases[c].name[i] = '_'; /* names are baseline fields */
+    }
+    if (!cases[c].pattern_file.empty() && !load_case(cases[c], format)) {
+      cout << cases[c].name << ": could not read the instance" << endl;
+      failed = true;
+      continue;
+    }
+    for (size_t h = 0; h < NUM_HEURISTICS; ++h) {
+      if (!only.empty() && only != heuristic_names[h]) continue;
+      BenchResult best;
+      for (size_t k = 0; k < repeat; ++k) {
+        BenchResult r = run(cases[c], (Var_selection) h, timeout_ms);
+        if (k == 0 || r.total < best.total) best = r;
+      }
+      write_result(results, cases[c].name, heuristic_names[h], best);
+
+      string key = cases[c].name + " " + heuristic_names[h];
+      char line[256];
+      snprintf(line, sizeof(line), "%-22s %-22s %-8s %10.3f ms", cases[c].name.c_str(), heuristic_names[h],
+               best.result.c_str(), best.total);
+      cout << line;
+      map<string, BenchResult>::iterator it = baseline.find(key);
+      if (it != baseline.end()) {
+        const BenchResult& old = it->second;
+        snprintf(line, sizeof(line), "  baseline %10.3f ms (x%.2f)", old.total, old.total > 0 ? best.total / old.total : 0);
+        cout << line;
+        if (old.result != "Unknown" && best.result != "Unknown" && old.result != best.result) {
+          cout << "  WRONG ANSWER (was " << old.result << ")";
+          failed = true;
+        } else if (best.total > old.total * (1 + tolerance) && best.total - old.total > slack_ms) {
+          cout << "  SLOWER";
+          failed = true;
+        }
+      }
+      cout << endl;
+    }
+    if (!cases[c].pattern_file.empty()) {
+      cases[c].a = Str();
+      cases[c].b = Str();
+    }
+  }
+
+  if (!save.empty()) {
+    ofstream outs(save);
+    outs << results.str();
+    if (!outs) {
+      cerr << "Could not write " << save << endl;
+      return 1;
+    }
+  }
+  return failed ? 1 : 0;
+}
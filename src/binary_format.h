@@ -0,0 +1,284 @@
+/****************************************************************************
+    Author: Charlie Murphy
+    Email:  tcm3@cs.princeton.edu
+
+    Date:   October 18, 2026
+
+    Description: Compact binary structure files (.bstruct)
+
+    A file is a sequence of 64 bit words in native byte order:
+
+      magic, version, byte order mark, #predicates, #structures
+      predicate names: offsets[#predicates + 1], characters (padded to a word)
+      for each structure:
+        #elements, #propositions, #arguments, flags, #signature words
+        element names: offsets[#elements + 1], characters (padded to a word)
+        predicate of each proposition[#propositions]
+        argument offsets[#propositions + 1]
+        arguments[#arguments]
+        signatures[#signature words]      (if flags & BSTRUCT_SIGNATURES)
+
+    Propositions are grouped by predicate. Predicate ids index the predicate
+    name table, which the writer fills with every relation symbol known to the
+    process so that files loaded into a fresh process use their ids as is. The
+    proposition arrays are used in place from the mapping whenever the file's
+    predicate ids agree with the process' relation ids; so are the stored
+    signatures, which are otherwise recomputed from the remapped propositions.
+ ****************************************************************************/
+#include <fstream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include "structure.h"
+#include "mapped_file.h"
+
+#ifndef CM_BINARY_FORMAT_H
+#define CM_BINARY_FORMAT_H
+
+static const uint64_t BSTRUCT_MAGIC = 0x5443555254534245ULL; /* "EBSTRUCT" */
+static const uint64_t BSTRUCT_VERSION = 1;
+static const uint64_t BSTRUCT_BOM = 0x0102030405060708ULL;
+static const uint64_t BSTRUCT_SIGNATURES = 1;
+
+/* Append a name table (offsets then word padded characters) to out */
+template <class Names>
+void write_name_table(std::vector<uint64_t>& out, const Names& names, size_t n) {
+  std::string chars;
+  out.push_back(0);
+  for (size_t i = 0; i < n; ++i) {
+    chars += names(i);
+    out.push_back(chars.size());
+  }
+  size_t words = (chars.size() + 7) / 8;
+  size_t start = out.size();
+  out.resize(start + words, 0);
+  if (!chars.empty()) memcpy(&out[start], chars.data(), chars.size());
+}
+
+/* Write structures to file_name in the binary format, with precomputed
+   signatures if signatures is set (requires Signature::write) */
+template <class Signature>
+bool write_binary_structures(const std::string& file_name,
+                             const std::vector<const Structure<std::string, std::string, Signature>*>& structs,
+                             bool signatures) {
+  typedef Structure<std::string, std::string, Signature> Str;
+  std::vector<uint64_t> out;
+  out.push_back(BSTRUCT_MAGIC);
+  out.push_back(BSTRUCT_VERSION);
+  out.push_back(BSTRUCT_BOM);
+  out.push_back(Str::num_relations());
+  out.push_back(structs.size());
+  write_name_table(out, [](size_t q) -> const std::string& { return Str::relation(q); }, Str::num_relations());
+
+  for (size_t k = 0; k < structs.size(); ++k) {
+    const Str& s = *structs[k];
+    const PropTable& props = s.propositions();
+
+    std::vector<size_t> order(props.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&props](size_t x, size_t y) { return props.pred(x) < props.pred(y); });
+
+    std::vector<uint64_t> sigs;
+    if (signatures) {
+      for (size_t i = 0; i < s.universe_size(); ++i) {
+        s.get_signature(i).write(sigs);
+      }
+    }
+
+    out.push_back(s.universe_size());
+    out.push_back(props.size());
+    out.push_back(props.num_args());
+    out.push_back(signatures ? BSTRUCT_SIGNATURES : 0);
+    out.push_back(sigs.size());
+    write_name_table(out, [&s](size_t u) -> const std::string& { return s.element(u); }, s.universe_size());
+    for (size_t i = 0; i < order.size(); ++i) {
+      out.push_back(props.pred(order[i]));
+    }
+    out.push_back(0);
+    for (size_t i = 0, n = 0; i < order.size(); ++i) {
+      n += props.arity(order[i]);
+      out.push_back(n);
+    }
+    for (size_t i = 0; i < order.size(); ++i) {
+      out.insert(out.end(), props.vars(order[i]), props.vars(order[i]) + props.arity(order[i]));
+    }
+    out.insert(out.end(), sigs.begin(), sigs.end());
+  }
+
+  std::ofstream outs(file_name, std::ios::binary);
+  outs.write(reinterpret_cast<const char*>(out.data()), out.size() * sizeof(uint64_t));
+  return (bool) outs;
+}
+
+/* Reads the structures of a binary structure file one after another. The
+   file stays mapped for as long as any structure read from it is alive. */
+template <class Signature>
+class BinaryStructReader {
+ public:
+  typedef Structure<std::string, std::string, Signature> Str;
+
+  explicit BinaryStructReader(const std::string& file_name) :
+    file_(new MappedFile(file_name)), pos_(0), remaining_(0), error_(0), valid_(false) {
+    static_assert(sizeof(size_t) == sizeof(uint64_t), "binary structures are used in place as size_t arrays");
+    if (!file_->is_open()) return;
+    words_ = reinterpret_cast<const uint64_t*>(file_->data());
+    n_words_ = file_->size() / sizeof(uint64_t);
+    uint64_t header[5];
+    if (!take(header, 5) || header[0] != BSTRUCT_MAGIC || header[1] != BSTRUCT_VERSION || header[2] != BSTRUCT_BOM) {
+      error_ = 0;
+      return;
+    }
+    const uint64_t* offsets;
+    const char* chars;
+    if (!names(header[3], offsets, chars)) return;
+    identity_ = true;
+    for (size_t q = 0; q < header[3]; ++q) {
+      pred_ids_.push_back(Str::add_relation(std::string(chars + offsets[q], offsets[q+1] - offsets[q])));
+      identity_ = identity_ && pred_ids_[q] == q;
+    }
+    remaining_ = header[4];
+    valid_ = true;
+  }
+
+  bool is_open() const { return file_->is_open(); }
+
+  /* Byte offset of the last format error */
+  size_t error_offset() const { return error_; }
+
+  /* Read the next structure in the file; valid is set to false on error */
+  Str next(bool& valid) {
+    Str s;
+    if (!valid_ || remaining_ == 0) {
+      valid = false;
+      error_ = pos_ * sizeof(uint64_t);
+      return s;
+    }
+    --remaining_;
+    uint64_t header[5];
+    const uint64_t* offsets;
+    const char* chars;
+    if (!take(header, 5) || !names(header[0], offsets, chars)) {
+      valid = valid_ = false;
+      return s;
+    }
+    size_t n_elems = header[0], n_props = header[1], n_args = header[2];
+    size_t start = pos_;
+    if (n_props > n_words_ || n_args > n_words_ || !skip(2 * n_props + 1 + n_args)) {
+      valid = valid_ = false;
+      return s;
+    }
+    const uint64_t* preds = words_ + start;
+    const uint64_t* arg_offsets = preds + n_props;
+    const uint64_t* args = arg_offsets + n_props + 1;
+    /* every argument must be an element and every predicate a known symbol */
+    bool ok = arg_offsets[0] == 0 && arg_offsets[n_props] == n_args;
+    for (size_t i = 0; ok && i < n_props; ++i) {
+      ok = preds[i] < pred_ids_.size() && arg_offsets[i] <= arg_offsets[i+1];
+    }
+    for (size_t i = 0; ok && i < n_args; ++i) {
+      ok = args[i] < n_elems;
+    }
+    if (!ok) {
+      error_ = start * sizeof(uint64_t);
+      valid = valid_ = false;
+      return s;
+    }
+
+    s.elements.reserve(n_elems);
+    for (size_t i = 0; i < n_elems; ++i) {
+      s.elements.push_back(std::string(chars + offsets[i], offsets[i+1] - offsets[i]));
+      s.signatures.push_back(Signature(i));
+    }
+
+    if (identity_) {
+      s.props.borrow(reinterpret_cast<const size_t*>(preds), reinterpret_cast<const size_t*>(arg_offsets),
+                     reinterpret_cast<const size_t*>(args), n_props, file_);
+    } else {
+      std::vector<size_t> local(preds, preds + n_props);
+      for (size_t i = 0; i < n_props; ++i) local[i] = pred_ids_[local[i]];
+      s.props.reserve(n_props, n_args);
+      for (size_t i = 0; i < n_props; ++i) {
+        s.props.push_back(local[i], args + arg_offsets[i], arg_offsets[i+1] - arg_offsets[i]);
+      }
+    }
+
+    /* stored signatures are keyed by the file's predicate ids, so they are
+       only usable when those are the relation ids */
+    bool stored = header[3] & BSTRUCT_SIGNATURES;
+    if (stored) {
+      const uint64_t* sig = words_ + pos_;
+      if (!skip(header[4])) {
+        valid = valid_ = false;
+        return s;
+      }
+      for (size_t i = 0; identity_ && sig != NULL && i < n_elems; ++i) {
+        sig = s.signatures[i].read(sig, words_ + pos_);
+      }
+      if (identity_ && sig != words_ + pos_) {
+        error_ = (pos_ - header[4]) * sizeof(uint64_t);
+        valid = valid_ = false;
+        return s;
+      }
+    }
+    if (!stored || !identity_) {
+      for (size_t i = 0; i < n_props; ++i) {
+        const size_t* vars = s.props.vars(i);
+        for (size_t k = 0; k < s.props.arity(i); ++k) {
+          s.signatures[vars[k]].update_signature(s.props.pred(i), vars, s.props.arity(i), k);
+        }
+      }
+    }
+    return s;
+  }
+
+ private:
+  std::shared_ptr<MappedFile> file_;
+  const uint64_t* words_;
+  size_t n_words_;
+  size_t pos_;          /* next word to read */
+  size_t remaining_;    /* structures not yet read */
+  size_t error_;
+  bool valid_;
+  bool identity_;       /* file predicate ids equal relation ids */
+  std::vector<size_t> pred_ids_;
+
+  bool skip(size_t n) {
+    if (n > n_words_ - pos_) {
+      error_ = pos_ * sizeof(uint64_t);
+      return false;
+    }
+    pos_ += n;
+    return true;
+  }
+
+  bool take(uint64_t* out, size_t n) {
+    size_t start = pos_;
+    if (!skip(n)) return false;
+    std::copy(words_ + start, words_ + start + n, out);
+    return true;
+  }
+
+  /* Locate a name table of n names at the current position */
+  bool names(size_t n, const uint64_t*& offsets, const char*& chars) {
+    size_t start = pos_;
+    if (n >= n_words_ || !skip(n + 1)) return false;
+    offsets = words_ + start;
+    for (size_t i = 0; i < n; ++i) {
+      if (offsets[i] > offsets[i+1]) {
+        error_ = (start + i) * sizeof(uint64_t);
+        return false;
+      }
+    }
+    chars = reinterpret_cast<const char*>(words_ + pos_);
+    if (offsets[n] > 8 * (n_words_ - pos_)) {
+      error_ = (start + n) * sizeof(uint64_t);
+      return false;
+    }
+    return skip((offsets[n] + 7) / 8);
+  }
+};
+
+#endif
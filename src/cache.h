@@ -0,0 +1,364 @@
+/*****************************************************************************
+  Author: Charlie Murphy
+  Email:  tcm3@cs.princeton.edu
+
+  Date:   October 18, 2026
+
+  Description: A cache of embedding results keyed by the structures up to
+    renaming. Each structure gets a canonical form: its elements are ordered
+    by colour refinement (an element's colour is refined by the relations,
+    positions and colours of the tuples it occurs in until the partition is
+    stable), individualizing one element of the smallest remaining class at
+    a time until every class is a single element, and its tuples are then
+    listed sorted under that order. Isomorphic structures usually get the
+    same form; when the individualized elements are not interchangeable the
+    forms may differ, which only costs a miss. A hit compares the forms
+    exactly, so a hash collision never returns a wrong result.
+
+    The cache stores the result and, for an embedding, the witness in
+    canonical labels, evicts the least recently used entries beyond its
+    byte capacity, and can be saved to and loaded from a file.
+ *****************************************************************************/
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+#include "definitions.h"
+#include "structure.h"
+#include "limits.h"
+
+#ifndef CM_CACHE_H
+#define CM_CACHE_H
+
+/* Version of the files written by ResultCache::save */
+static const size_t CACHE_FILE_VERSION = 2;
+
+/* A structure with its elements relabelled in canonical order */
+struct CanonicalForm {
+  std::vector<size_t> label;  /* canonical label of each element */
+  std::vector<size_t> code;   /* universe size, number of tuples, then the (relation, arity, labels...) of each tuple in order */
+  uint64_t hash;
+};
+
+/* Elements individualized before the remaining ties are broken by index */
+static const size_t MAX_INDIVIDUALIZED = 64;
+
+/* Refine the colours of the n elements of props until the partition is
+   stable. Colours are ranks of (colour, occurrences) keys, so they do not
+   depend on the names of the elements. Returns the number of colours. */
+inline size_t refine_colours(const PropTable& props, const std::vector<size_t>& occ_begin,
+                             const std::vector<Graph::Edge>& occ, std::vector<size_t>& colour) {
+  size_t n = colour.size();
+  std::vector<size_t> distinct(colour);
+  std::sort(distinct.begin(), distinct.end());
+  size_t classes = std::unique(distinct.begin(), distinct.end()) - distinct.begin();
+  std::vector<std::pair<std::vector<size_t>, size_t>> keys(n);
+  std::vector<std::vector<size_t>> tuples;
+  while (true) {
+    for (size_t v = 0; v < n; ++v) {
+      tuples.clear();
+      for (size_t i = occ_begin[v]; i < occ_begin[v + 1]; ++i) {
+        size_t p = occ[i].vertex;
+        std::vector<size_t> t(1, props.pred(p));
+        t.push_back(occ[i].position);
+        for (size_t k = 0; k < props.arity(p); ++k) t.push_back(colour[props.vars(p)[k]]);
+        tuples.push_back(t);
+      }
+      std::sort(tuples.begin(), tuples.end());
+      std::vector<size_t>& key = keys[v].first;
+      key.assign(1, colour[v]);
+      for (size_t i = 0; i < tuples.size(); ++i) {
+        key.push_back(tuples[i].size());
+        key.insert(key.end(), tuples[i].begin(), tuples[i].end());
+      }
+      keys[v].second = v;
+    }
+    std::sort(keys.begin(), keys.end());
+    size_t c = 0;
+    for (size_t i = 0; i < n; ++i) {
+      if (i > 0 && keys[i].first != keys[i - 1].first) ++c;
+      colour[keys[i].second] = c;
+    }
+    if (c + 1 == classes || n == 0) return classes;
+    classes = c + 1;
+  }
+}
+
+/* The canonical form of the structure with n elements and propositions props */
+inline CanonicalForm canonical_form(const PropTable& props, size_t n) {
+  /* occurrences (proposition, position) of each element */
+  std::vector<size_t> occ_begin(n + 1, 0);
+  for (size_t i = 0; i < props.num_args(); ++i) ++occ_begin[props.args()[i] + 1];
+  for (size_t v = 0; v < n; ++v) occ_begin[v + 1] += occ_begin[v];
+  std::vector<Graph::Edge> occ(props.num_args());
+  std::vector<size_t> fill(occ_begin.begin(), occ_begin.end() - 1);
+  for (size_t p = 0; p < props.size(); ++p) {
+    for (size_t k = 0; k < props.arity(p); ++k) occ[fill[props.vars(p)[k]]++] = Graph::Edge(p, k);
+  }
+
+  std::vector<size_t> colour(n, 0);
+  size_t classes = refine_colours(props, occ_begin, occ, colour);
+  for (size_t individualized = 0; classes < n; ++individualized) {
+    std::vector<size_t> size(classes, 0), first(classes, n);
+    for (size_t v = 0; v < n; ++v) {
+      ++size[colour[v]];
+      first[colour[v]] = std::min(first[colour[v]], v);
+    }
+    if (individualized == MAX_INDIVIDUALIZED) {
+      /* break the remaining ties by index */
+      std::vector<std::pair<size_t, size_t>> order(n);
+      for (size_t v = 0; v < n; ++v) order[v] = std::make_pair(colour[v], v);
+      std::sort(order.begin(), order.end());
+      for (size_t i = 0; i < n; ++i) colour[order[i].second] = i;
+      break;
+    }
+    /* the first element of the smallest class with more than one */
+    size_t best = classes;
+    for (size_t c = 0; c < classes; ++c) {
+      if (size[c] > 1 && (best == classes || size[c] < size[best])) best = c;
+    }
+    for (size_t v = 0; v < n; ++v) colour[v] = 2 * colour[v] + (v != first[best]);
+    classes = refine_colours(props, occ_begin, occ, colour);
+  }
+
+  CanonicalForm f;
+  f.label.swap(colour);
+  std::vector<std::vector<size_t>> tuples(props.size());
+  for (size_t p = 0; p < props.size(); ++p) {
+    tuples[p].push_back(props.pred(p));
+    tuples[p].push_back(props.arity(p));
+    for (size_t k = 0; k < props.arity(p); ++k) tuples[p].push_back(f.label[props.vars(p)[k]]);
+  }
+  std::sort(tuples.begin(), tuples.end());
+  f.code.push_back(n);
+  f.code.push_back(props.size());
+  for (size_t p = 0; p < tuples.size(); ++p) f.code.insert(f.code.end(), tuples[p].begin(), tuples[p].end());
+  f.hash = 0x9e3779b97f4a7c15ULL;
+  for (size_t i = 0; i < f.code.size(); ++i) {
+    f.hash ^= ((uint64_t) f.code[i] + 0x9e3779b97f4a7c15ULL + (f.hash << 6) + (f.hash >> 2)) * 0xff51afd7ed558ccdULL;
+  }
+  return f;
+}
+
+template <class Element, class Predicate, class Signature>
+CanonicalForm canonical_form(const Structure<Element, Predicate, Signature>& s) {
+  return canonical_form(s.propositions(), s.universe_size());
+}
+
+/* Counters of a ResultCache */
+struct CacheStats {
+  CacheStats() : hits(0), misses(0), evictions(0), entries(0), bytes(0) {}
+  size_t hits;
+  size_t misses;
+  size_t evictions;
+  size_t entries;
+  size_t bytes;
+};
+
+template <class Element, class Predicate, class Signature>
+class ResultCache {
+  public:
+    typedef Structure<Element, Predicate, Signature> Str;
+
+    /* A cache holding entries of at most capacity bytes in total (roughly) */
+    explicit ResultCache(size_t capacity) : capacity_(capacity) {}
+
+    /* The cached result of embedding the structure with form a into the one
+       with form b, if any. For SAT, witness (if given) receives the image of
+       each element of a. UNKNOWN results are never cached. */
+    bool lookup(const CanonicalForm& a, const CanonicalForm& b, Search_result& r, std::vector<size_t>* witness = NULL) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      typename std::list<Entry>::iterator it = find(a, b);
+      if (it == lru_.end()) {
+        ++stats_.misses;
+        return false;
+      }
+      ++stats_.hits;
+      lru_.splice(lru_.begin(), lru_, it);
+      r = it->result;
+      if (witness != NULL && r == SAT) {
+        /* canonical labels of b back to its elements */
+        std::vector<size_t> element(b.label.size());
+        for (size_t v = 0; v < b.label.size(); ++v) element[b.label[v]] = v;
+        witness->resize(a.label.size());
+        for (size_t u = 0; u < a.label.size(); ++u) (*witness)[u] = element[it->witness[a.label[u]]];
+      }
+      return true;
+    }
+
+    /* Cache the result r of embedding a into b; for SAT solution[u] is the
+       image of element u of a (as in Embedding::solution) */
+    void store(const CanonicalForm& a, const CanonicalForm& b, Search_result r, const std::vector<int>& solution) {
+      if (r == UNKNOWN) return;
+      Entry e;
+      e.key = key(a, b);
+      e.a_code = a.code;
+      e.b_code = b.code;
+      e.result = r;
+      if (r == SAT) {
+        e.witness.resize(a.label.size());
+        for (size_t u = 0; u < a.label.size(); ++u) e.witness[a.label[u]] = b.label[solution[u]];
+      }
+      e.bytes = sizeof(Entry) + sizeof(size_t) * (e.a_code.size() + e.b_code.size() + e.witness.size() + 4);
+      if (e.bytes > capacity_) return;
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      typename std::list<Entry>::iterator it = find(a, b);
+      if (it != lru_.end()) {
+        lru_.splice(lru_.begin(), lru_, it);
+        return;
+      }
+      stats_.bytes += e.bytes;
+      ++stats_.entries;
+      lru_.push_front(Entry());
+      lru_.front().swap(e);
+      index_.insert(std::make_pair(lru_.front().key, lru_.begin()));
+      while (stats_.bytes > capacity_) evict();
+    }
+
+    CacheStats stats() const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return stats_;
+    }
+
+    /* Write the entries, least recently used first, with relation symbols by name */
+    bool save(const std::string& file_name) const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      std::ofstream outs(file_name);
+      outs << "match-embeds-cache " << CACHE_FILE_VERSION << " " << lru_.size() << "\n";
+      for (typename std::list<Entry>::const_reverse_iterator it = lru_.rbegin(); it != lru_.rend(); ++it) {
+        outs << (int) it->result << "\n";
+        write_code(outs, it->a_code);
+        write_code(outs, it->b_code);
+        for (size_t i = 0; i < it->witness.size(); ++i) outs << (i == 0 ? "" : " ") << it->witness[i];
+        outs << "\n";
+      }
+      return (bool) outs;
+    }
+
+    /* Add the entries of a file written by save. The forms are recomputed,
+       since relation symbol ids differ between runs. */
+    bool load(const std::string& file_name) {
+      std::ifstream ins(file_name);
+      std::string magic;
+      size_t version, n;
+      if (!(ins >> magic >> version >> n) || magic != "match-embeds-cache" || version != CACHE_FILE_VERSION) return false;
+      for (size_t i = 0; i < n; ++i) {
+        int result;
+        PropTable a, b;
+        size_t a_size, b_size;
+        if (!(ins >> result) || !read_code(ins, a, a_size) || !read_code(ins, b, b_size)) return false;
+        std::vector<int> solution(result == SAT ? a_size : 0);
+        for (size_t u = 0; u < solution.size(); ++u) {
+          if (!(ins >> solution[u]) || solution[u] < 0 || (size_t) solution[u] >= b_size) return false;
+        }
+        store(canonical_form(a, a_size), canonical_form(b, b_size), (Search_result) result, solution);
+      }
+      return true;
+    }
+
+  private:
+    struct Entry {
+      uint64_t key;
+      std::vector<size_t> a_code;
+      std::vector<size_t> b_code;
+      Search_result result;
+      std::vector<size_t> witness;  /* canonical label in b of the image of each canonical label in a */
+      size_t bytes;
+
+      void swap(Entry& o) {
+        std::swap(key, o.key);
+        a_code.swap(o.a_code);
+        b_code.swap(o.b_code);
+        std::swap(result, o.result);
+        witness.swap(o.witness);
+        std::swap(bytes, o.bytes);
+      }
+    };
+
+    size_t capacity_;
+    std::list<Entry> lru_;  /* most recently used first */
+    std::unordered_multimap<uint64_t, typename std::list<Entry>::iterator> index_;
+    CacheStats stats_;
+    mutable std::mutex mutex_;
+
+    static uint64_t key(const CanonicalForm& a, const CanonicalForm& b) {
+      return a.hash ^ (b.hash * 0xc4ceb9fe1a85ec53ULL + 0x9e3779b97f4a7c15ULL);
+    }
+
+    typename std::list<Entry>::iterator find(const CanonicalForm& a, const CanonicalForm& b) {
+      uint64_t k = key(a, b);
+      typedef typename std::unordered_multimap<uint64_t, typename std::list<Entry>::iterator>::iterator Index;
+      std::pair<Index, Index> range = index_.equal_range(k);
+      for (Index i = range.first; i != range.second; ++i) {
+        if (i->second->a_code == a.code && i->second->b_code == b.code) return i->second;
+      }
+      return lru_.end();
+    }
+
+    void evict() {
+      typename std::list<Entry>::iterator last = --lru_.end();
+      typedef typename std::unordered_multimap<uint64_t, typename std::list<Entry>::iterator>::iterator Index;
+      std::pair<Index, Index> range = index_.equal_range(last->key);
+      for (Index i = range.first; i != range.second; ++i) {
+        if (i->second == last) {
+          index_.erase(i);
+          break;
+        }
+      }
+      stats_.bytes -= last->bytes;
+      --stats_.entries;
+      ++stats_.evictions;
+      lru_.erase(last);
+    }
+
+    /* universe size, number of tuples, then one line per tuple: relation arity labels...
+       with the relation's name preceded by its length, as it may hold spaces */
+    static void write_code(std::ostream& outs, const std::vector<size_t>& code) {
+      outs << code[0] << " " << code[1] << "\n";
+      for (size_t i = 2; i < code.size(); i += code[i + 1] + 2) {
+        std::ostringstream name;
+        name << Str::relation(code[i]);
+        outs << name.str().size() << " " << name.str() << " " << code[i + 1];
+        for (size_t k = 0; k < code[i + 1]; ++k) outs << " " << code[i + 2 + k];
+        outs << "\n";
+      }
+    }
+
+    static bool parse_name(const std::string& name, std::string& p) {
+      p = name;
+      return true;
+    }
+    template <class Name>
+    static bool parse_name(const std::string& name, Name& p) {
+      std::istringstream ins(name);
+      return (bool) (ins >> p);
+    }
+
+    static bool read_code(std::istream& ins, PropTable& props, size_t& n) {
+      size_t m;
+      if (!(ins >> n >> m)) return false;
+      std::vector<size_t> vars;
+      for (size_t i = 0; i < m; ++i) {
+        Predicate p;
+        size_t len, arity;
+        if (!(ins >> len) || ins.get() != ' ') return false;
+        std::string name(len, '\0');
+        if (!ins.read(&name[0], len) || !parse_name(name, p) || !(ins >> arity)) return false;
+        vars.resize(arity);
+        for (size_t k = 0; k < arity; ++k) {
+          if (!(ins >> vars[k]) || vars[k] >= n) return false;
+        }
+        props.push_back(Str::add_relation(p), vars.data(), arity);
+      }
+      return true;
+    }
+};
+
+#endif
@@ -0,0 +1,110 @@
+/*****************************************************************************
+  Author: Charlie Murphy
+  Email:  tcm3@cs.princeton.edu
+
+  Date:   October 18, 2026
+
+  Description: Connected components of a pattern structure. Two elements
+    are connected when they occur in a common tuple; elements occurring in
+    no tuple are isolated and belong to no component. Distinct components
+    constrain each other only through injectivity, so each can be solved on
+    its own: if one has no embedding neither has the pattern, and embeddings
+    of the components with disjoint images combine into one of the pattern.
+ *****************************************************************************/
+
+#include <vector>
+#include <algorithm>
+#include "structure.h"
+#include "definitions.h"
+
+#ifndef CM_COMPONENTS_H
+#define CM_COMPONENTS_H
+
+/* The component of an isolated element */
+static const size_t NO_COMPONENT = (size_t) -1;
+
+struct PatternComponents {
+  std::vector<size_t> component;             /* index in members of the component of each element (NO_COMPONENT if isolated) */
+  std::vector<std::vector<size_t>> members;  /* elements of each component, the ones with the most tuples first */
+  std::vector<size_t> isolated;              /* elements occurring in no tuple */
+};
+
+/* The components of the structure with n elements and propositions props */
+inline PatternComponents pattern_components(const PropTable& props, size_t n) {
+  /* union-find over the elements, joining the arguments of each tuple */
+  std::vector<size_t> parent(n);
+  for (size_t v = 0; v < n; ++v) parent[v] = v;
+  std::vector<char> used(n, 0);
+  for (size_t p = 0; p < props.size(); ++p) {
+    const size_t* vars = props.vars(p);
+    for (size_t k = 0; k < props.arity(p); ++k) {
+      used[vars[k]] = 1;
+      size_t x = vars[0], y = vars[k];
+      while (parent[x] != x) x = parent[x] = parent[parent[x]];
+      while (parent[y] != y) y = parent[y] = parent[parent[y]];
+      if (x != y) parent[std::max(x, y)] = std::min(x, y);
+    }
+  }
+  PatternComponents c;
+  c.component.assign(n, NO_COMPONENT);
+  std::vector<size_t> root_of(n, NO_COMPONENT);
+  for (size_t v = 0; v < n; ++v) {
+    if (!used[v]) {
+      c.isolated.push_back(v);
+      continue;
+    }
+    size_t r = v;
+    while (parent[r] != r) r = parent[r];
+    if (root_of[r] == NO_COMPONENT) {
+      root_of[r] = c.members.size();
+      c.members.push_back(std::vector<size_t>());
+    }
+    c.members[root_of[r]].push_back(v);
+  }
+
+  /* order by number of tuples, then of elements, largest first */
+  std::vector<size_t> tuples(c.members.size(), 0);
+  for (size_t p = 0; p < props.size(); ++p) {
+    if (props.arity(p) == 0) continue;
+    size_t r = props.vars(p)[0];
+    while (parent[r] != r) r = parent[r];
+    ++tuples[root_of[r]];
+  }
+  std::vector<size_t> order(c.members.size());
+  for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&](size_t x, size_t y) {
+    return tuples[x] != tuples[y] ? tuples[x] > tuples[y] : c.members[x].size() > c.members[y].size();
+  });
+  std::vector<std::vector<size_t>> members(order.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    members[i].swap(c.members[order[i]]);
+    for (size_t j = 0; j < members[i].size(); ++j) c.component[members[i][j]] = i;
+  }
+  c.members.swap(members);
+  return c;
+}
+
+/* The substructure of a on the elements of a component (with their names),
+   holding every tuple of a over them */
+template <class Element, class Predicate, class Signature>
+Structure<Element, Predicate, Signature> component_structure(const Structure<Element, Predicate, Signature>& a,
+                                                            const PatternComponents& c, size_t i) {
+  Structure<Element, Predicate, Signature> s;
+  const std::vector<size_t>& members = c.members[i];
+  std::vector<size_t> local(a.universe_size(), 0);
+  for (size_t j = 0; j < members.size(); ++j) {
+    local[members[j]] = j;
+    s.add_element(a.element(members[j]));
+  }
+  const PropTable& props = a.propositions();
+  std::vector<size_t> vars;
+  for (size_t p = 0; p < props.size(); ++p) {
+    if (props.arity(p) == 0 || c.component[props.vars(p)[0]] != i) continue;
+    vars.resize(props.arity(p));
+    for (size_t k = 0; k < vars.size(); ++k) vars[k] = local[props.vars(p)[k]];
+    s.add_proposition(props.pred(p), vars.data(), vars.size());
+  }
+  return s;
+}
+
+#endif
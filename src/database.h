@@ -0,0 +1,246 @@
+/*****************************************************************************
+  Author: Charlie Murphy
+  Email:  tcm3@cs.princeton.edu
+
+  Date:   October 18, 2026
+
+  Description: A database of target structures screened by features. Every
+    feature is a count that cannot decrease along an embedding (which is
+    injective on elements and on tuples and keeps argument positions), so a
+    target with a smaller count than the pattern for some feature is
+    rejected without building an Embedding:
+
+      the number of elements and the number of tuples of each relation,
+      for each (relation, position) the number of elements occurring there
+        and the MAX_RANKS largest numbers of occurrences of one element,
+      for each pair of (relation, position)s the number of pairs of distinct
+        tuples sharing an element at those positions (paths of length two).
+
+    Each feature has a posting list of the targets having it, sorted by
+    count. A query walks the list of its most selective feature only, tests
+    the remaining features on those targets, and verifies the survivors with
+    MatchEmbeds on a thread pool.
+ *****************************************************************************/
+
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+#include "structure.h"
+#include "embedding.h"
+#include "match_embeds.h"
+#include "thread_pool.h"
+
+#ifndef CM_DATABASE_H
+#define CM_DATABASE_H
+
+/* Features of a structure: (key, count) pairs sorted by key, with every count positive */
+typedef std::vector<std::pair<uint64_t, uint64_t>> FeatureVector;
+
+/* Kinds of features, in the top bits of a key */
+enum Feature_kind {
+  FEATURE_ELEMENTS = 0,
+  FEATURE_TUPLES,      // relation
+  FEATURE_SUPPORT,     // relation, position
+  FEATURE_RANK,        // relation, position, rank
+  FEATURE_WEDGES,      // relation, position, relation, position
+};
+
+/* Relation symbols and positions are packed into 20 and 8 bits of a key;
+   larger ones share keys, whose counts are added up, which only makes the
+   screening weaker */
+inline uint64_t feature_key(Feature_kind kind, size_t r = 0, size_t i = 0, size_t s = 0, size_t j = 0) {
+  return ((uint64_t) kind << 60) | ((uint64_t) (r & 0xfffff) << 36) | ((uint64_t) (i & 0xff) << 28)
+         | ((uint64_t) (s & 0xfffff) << 8) | (uint64_t) (j & 0xff);
+}
+
+/* Largest numbers of occurrences of one element at a (relation, position) kept as features */
+static const size_t MAX_RANKS = 4;
+
+template <class Element, class Predicate, class Signature>
+FeatureVector structure_features(const Structure<Element, Predicate, Signature>& s) {
+  const PropTable& props = s.propositions();
+  std::map<uint64_t, uint64_t> features;
+  if (s.universe_size() != 0) features[feature_key(FEATURE_ELEMENTS)] = s.universe_size();
+
+  /* occurrences of each element at each (relation, position) */
+  std::vector<std::vector<std::pair<size_t, size_t>>> occ(s.universe_size());
+  for (size_t t = 0; t < props.size(); ++t) {
+    ++features[feature_key(FEATURE_TUPLES, props.pred(t))];
+    const size_t* vars = props.vars(t);
+    for (size_t k = 0; k < props.arity(t); ++k) {
+      occ[vars[k]].emplace_back(props.pred(t), k);
+      /* a tuple repeating an element pairs with itself below; take it back out */
+      for (size_t l = k + 1; l < props.arity(t); ++l) {
+        if (vars[l] == vars[k]) --features[feature_key(FEATURE_WEDGES, props.pred(t), k, props.pred(t), l)];
+      }
+    }
+  }
+  std::map<std::pair<size_t, size_t>, std::vector<uint64_t>> counts;
+  for (size_t v = 0; v < occ.size(); ++v) {
+    std::sort(occ[v].begin(), occ[v].end());
+    /* runs of equal (relation, position) */
+    std::vector<std::pair<std::pair<size_t, size_t>, uint64_t>> runs;
+    for (size_t i = 0; i < occ[v].size(); ++i) {
+      if (runs.empty() || runs.back().first != occ[v][i]) runs.push_back(std::make_pair(occ[v][i], 0));
+      ++runs.back().second;
+    }
+    for (size_t a = 0; a < runs.size(); ++a) {
+      counts[runs[a].first].push_back(runs[a].second);
+      uint64_t n = runs[a].second;
+      features[feature_key(FEATURE_WEDGES, runs[a].first.first, runs[a].first.second, runs[a].first.first, runs[a].first.second)] += n * (n - 1) / 2;
+      for (size_t b = a + 1; b < runs.size(); ++b) {
+        features[feature_key(FEATURE_WEDGES, runs[a].first.first, runs[a].first.second, runs[b].first.first, runs[b].first.second)] += n * runs[b].second;
+      }
+    }
+  }
+  for (std::map<std::pair<size_t, size_t>, std::vector<uint64_t>>::iterator it = counts.begin(); it != counts.end(); ++it) {
+    std::vector<uint64_t>& c = it->second;
+    features[feature_key(FEATURE_SUPPORT, it->first.first, it->first.second)] += c.size();
+    std::sort(c.begin(), c.end(), std::greater<uint64_t>());
+    for (size_t r = 0; r < c.size() && r < MAX_RANKS; ++r) {
+      features[feature_key(FEATURE_RANK, it->first.first, it->first.second, r)] += c[r];
+    }
+  }
+  FeatureVector f;
+  for (std::map<uint64_t, uint64_t>::iterator it = features.begin(); it != features.end(); ++it) {
+    if (it->second != 0) f.push_back(*it);
+  }
+  return f;
+}
+
+/* Is every count of a at most the count of the same feature in b? */
+inline bool dominated(const FeatureVector& a, const FeatureVector& b) {
+  size_t j = 0;
+  for (size_t i = 0; i < a.size(); ++i) {
+    while (j < b.size() && b[j].first < a[i].first) ++j;
+    if (j == b.size() || b[j].first != a[i].first || b[j].second < a[i].second) return false;
+  }
+  return true;
+}
+
+/* Work done by a database query */
+struct ScreenStats {
+  ScreenStats() : targets(0), scanned(0), candidates(0), matches(0) {}
+  size_t targets;      /* in the database */
+  size_t scanned;      /* on the posting list walked */
+  size_t candidates;   /* passing every feature test, verified with MatchEmbeds */
+  size_t matches;
+};
+
+template <class Element, class Predicate, class Signature>
+class TargetDatabase {
+  public:
+    typedef Structure<Element, Predicate, Signature> Str;
+
+    TargetDatabase() : sorted_(true) {}
+
+    /* Add b and return its id (ids are given out in order from 0) */
+    size_t add(std::shared_ptr<const Str> b) {
+      size_t id = targets_.size();
+      targets_.push_back(b);
+      features_.push_back(structure_features(*b));
+      const FeatureVector& f = features_.back();
+      for (size_t i = 0; i < f.size(); ++i) {
+        std::vector<std::pair<uint64_t, size_t>>& list = postings_[f[i].first];
+        list.emplace_back(f[i].second, id);
+        sorted_ = false;
+      }
+      return id;
+    }
+
+    size_t size() const { return targets_.size(); }
+    const Str& structure(size_t id) const { return *targets_[id]; }
+    const FeatureVector& features(size_t id) const { return features_[id]; }
+
+    /* Ids (in increasing order) of the targets passing every feature test for
+       a: a superset of the targets a embeds into. Queries must not run
+       concurrently with add. */
+    std::vector<size_t> candidates(const Str& a, ScreenStats* stats = NULL) {
+      sort_postings();
+      FeatureVector f = structure_features(a);
+      std::vector<size_t> ids;
+      if (stats != NULL) stats->targets = targets_.size();
+      if (f.empty()) {
+        for (size_t id = 0; id < targets_.size(); ++id) ids.push_back(id);
+      } else {
+        /* walk the shortest prefix of a posting list with large enough counts */
+        const std::vector<std::pair<uint64_t, size_t>>* best = NULL;
+        size_t best_size = 0;
+        for (size_t i = 0; i < f.size(); ++i) {
+          typename std::unordered_map<uint64_t, std::vector<std::pair<uint64_t, size_t>>>::const_iterator it = postings_.find(f[i].first);
+          size_t n = it == postings_.end() ? 0 : at_least(it->second, f[i].second);
+          if (best == NULL || n < best_size) {
+            best = it == postings_.end() ? NULL : &it->second;
+            best_size = n;
+          }
+          if (n == 0) break;
+        }
+        for (size_t i = 0; best != NULL && i < best_size; ++i) {
+          size_t id = (*best)[i].second;
+          if (dominated(f, features_[id])) ids.push_back(id);
+        }
+        if (stats != NULL) stats->scanned = best_size;
+        std::sort(ids.begin(), ids.end());
+      }
+      if (stats != NULL) stats->candidates = ids.size();
+      return ids;
+    }
+
+    /* Ids (in increasing order) of the targets a embeds into; the candidates
+       are verified on threads threads. The features only bound embeddings, so
+       with options.homomorphism every target is verified. */
+    std::vector<size_t> query(const Str& a, size_t threads = 1, ScreenStats* stats = NULL,
+                              const EmbeddingOptions& options = EmbeddingOptions()) {
+      std::vector<size_t> ids;
+      if (options.homomorphism) {
+        for (size_t id = 0; id < targets_.size(); ++id) ids.push_back(id);
+        if (stats != NULL) stats->targets = stats->scanned = stats->candidates = ids.size();
+      } else {
+        ids = candidates(a, stats);
+      }
+      std::vector<char> found(ids.size(), 0);
+      {
+        ThreadPool pool(std::min(threads, ids.size()));
+        for (size_t i = 0; i < ids.size(); ++i) {
+          pool.submit([this, &a, &ids, &found, &options, i]() {
+            Embedding<Element, Predicate, Signature> e(a, *targets_[ids[i]], options);
+            found[i] = MatchEmbeds(e);
+          });
+        }
+        pool.wait();
+      }
+      std::vector<size_t> matches;
+      for (size_t i = 0; i < ids.size(); ++i) {
+        if (found[i]) matches.push_back(ids[i]);
+      }
+      if (stats != NULL) stats->matches = matches.size();
+      return matches;
+    }
+
+  private:
+    std::vector<std::shared_ptr<const Str>> targets_;
+    std::vector<FeatureVector> features_;
+    /* (count, target) for each feature key, by decreasing count once sorted */
+    std::unordered_map<uint64_t, std::vector<std::pair<uint64_t, size_t>>> postings_;
+    bool sorted_;
+
+    void sort_postings() {
+      if (sorted_) return;
+      for (typename std::unordered_map<uint64_t, std::vector<std::pair<uint64_t, size_t>>>::iterator it = postings_.begin();
+           it != postings_.end(); ++it) {
+        std::sort(it->second.begin(), it->second.end(), std::greater<std::pair<uint64_t, size_t>>());
+      }
+      sorted_ = true;
+    }
+
+    /* Length of the prefix of list with count at least c */
+    static size_t at_least(const std::vector<std::pair<uint64_t, size_t>>& list, uint64_t c) {
+      return std::partition_point(list.begin(), list.end(), [c](const std::pair<uint64_t, size_t>& x) { return x.first >= c; }) - list.begin();
+    }
+};
+
+#endif
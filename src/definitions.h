@@ -9,20 +9,234 @@
 
 #include <vector>
 #include <cstdint>
+#include <algorithm>
+#include <memory>
 #include "graph.h"
 
 #ifndef CM_EMBEDDING_DEF_H
 #define CM_EMBEDDING_DEF_H
 
-/* The label for the proposition graph predicate symbol and list of arguments */
-struct prop{
-  prop (size_t p = 0) : pred(p) {}
-  /* copy semantics / cast to const if you want to copy a non-const vector*/
-  prop (size_t p, const std::vector<size_t>& v) : pred(p), vars(v) {}
-  /* move semantics (default) */
-  prop (size_t p, std::vector<size_t>& v) : pred(p), vars(std::move(v)) {}
-  size_t pred;
-  std::vector<size_t> vars;
+/* Propositions stored as a structure of arrays. Proposition i has predicate
+   symbol pred(i) and arguments args[offsets[i] .. offsets[i+1]), so the
+   arguments of every proposition in a structure live in one contiguous
+   array instead of one small vector per proposition.
+
+   A table either owns its arrays or borrows them from memory kept alive by
+   an owner (e.g. a mapped binary structure file); a borrowed table copies
+   its arrays the first time it is modified. */
+class PropTable {
+ public:
+  PropTable() : offsets_(1, 0), size_(0) { repoint(); }
+
+  PropTable(const PropTable& o) :
+    preds_(o.preds_), offsets_(o.offsets_), args_(o.args_), owner_(o.owner_), size_(o.size_) {
+    if (owner_) borrow(o);
+    else repoint();
+  }
+
+  PropTable(PropTable&& o) :
+    preds_(std::move(o.preds_)), offsets_(std::move(o.offsets_)), args_(std::move(o.args_)),
+    owner_(std::move(o.owner_)), size_(o.size_) {
+    if (owner_) borrow(o);
+    else repoint();
+    o.preds_.clear(); o.args_.clear();
+    o.offsets_.assign(1, 0);
+    o.size_ = 0;
+    o.repoint();
+  }
+
+  PropTable& operator = (PropTable o) {
+    swap(o);
+    return *this;
+  }
+
+  /* swapping vectors keeps their buffers, so owned pointers stay valid */
+  void swap(PropTable& o) {
+    preds_.swap(o.preds_);
+    offsets_.swap(o.offsets_);
+    args_.swap(o.args_);
+    owner_.swap(o.owner_);
+    std::swap(preds_p_, o.preds_p_);
+    std::swap(offsets_p_, o.offsets_p_);
+    std::swap(args_p_, o.args_p_);
+    std::swap(size_, o.size_);
+  }
+
+  size_t size() const { return size_; }
+  size_t num_args() const { return offsets_p_[size_]; }
+
+  size_t pred(size_t i) const { return preds_p_[i]; }
+  size_t arity(size_t i) const { return offsets_p_[i+1] - offsets_p_[i]; }
+  const size_t* vars(size_t i) const { return args_p_ + offsets_p_[i]; }
+
+  /* Heap bytes held by the arrays (none for borrowed ones) */
+  size_t memory_bytes() const { return heap_bytes(preds_) + heap_bytes(offsets_) + heap_bytes(args_); }
+
+  /* Raw arrays (size(), size() + 1 and num_args() entries) */
+  const size_t* preds() const { return preds_p_; }
+  const size_t* offsets() const { return offsets_p_; }
+  const size_t* args() const { return args_p_; }
+
+  /* Append p(vars[0], ..., vars[n-1]) and return its index */
+  size_t push_back(size_t p, const size_t* vars, size_t n) {
+    if (owner_) detach();
+    preds_.push_back(p);
+    args_.insert(args_.end(), vars, vars + n);
+    offsets_.push_back(args_.size());
+    repoint();
+    return size_++;
+  }
+
+  void reserve(size_t props, size_t args) {
+    if (owner_) detach();
+    preds_.reserve(props);
+    offsets_.reserve(props + 1);
+    args_.reserve(args);
+    repoint();
+  }
+
+  /* Remove the propositions i with dead[i] set, keeping the others in order.
+     Returns the new index of each old proposition (npos for removed ones). */
+  std::vector<size_t> erase(const std::vector<char>& dead) {
+    if (owner_) detach();
+    std::vector<size_t> renumber(size_, (size_t) -1);
+    size_t n = 0, args = 0;
+    for (size_t i = 0; i < size_; ++i) {
+      if (dead[i]) continue;
+      /* entries are only moved down, over ones already read */
+      size_t first = offsets_[i], last = offsets_[i + 1];
+      preds_[n] = preds_[i];
+      std::copy(args_.begin() + first, args_.begin() + last, args_.begin() + args);
+      args += last - first;
+      renumber[i] = n++;
+      offsets_[n] = args;
+    }
+    preds_.resize(n);
+    offsets_.resize(n + 1);
+    args_.resize(args);
+    size_ = n;
+    repoint();
+    return renumber;
+  }
+
+  /* Use n propositions stored in memory kept alive by owner without copying them */
+  void borrow(const size_t* preds, const size_t* offsets, const size_t* args, size_t n, std::shared_ptr<const void> owner) {
+    preds_.clear(); offsets_.clear(); args_.clear();
+    preds_p_ = preds; offsets_p_ = offsets; args_p_ = args;
+    size_ = n;
+    owner_ = owner;
+  }
+
+ private:
+  std::vector<size_t> preds_;
+  std::vector<size_t> offsets_;
+  std::vector<size_t> args_;
+  std::shared_ptr<const void> owner_;  /* set iff the arrays are borrowed */
+  const size_t* preds_p_;
+  const size_t* offsets_p_;
+  const size_t* args_p_;
+  size_t size_;
+
+  void repoint() {
+    preds_p_ = preds_.data();
+    offsets_p_ = offsets_.data();
+    args_p_ = args_.data();
+  }
+
+  void borrow(const PropTable& o) {
+    preds_p_ = o.preds_p_;
+    offsets_p_ = o.offsets_p_;
+    args_p_ = o.args_p_;
+  }
+
+  void detach() {
+    preds_.assign(preds_p_, preds_p_ + size_);
+    offsets_.assign(offsets_p_, offsets_p_ + size_ + 1);
+    args_.assign(args_p_, args_p_ + offsets_p_[size_]);
+    owner_.reset();
+    repoint();
+  }
+};
+
+/* Open addressing hash set of proposition indices into a PropTable, keyed by
+   (predicate, arguments). Slots hold index + 1 so that 0 marks an empty slot. */
+class TupleSet {
+ public:
+  static const size_t npos = (size_t) -1;
+
+  TupleSet() : count_(0) {}
+
+  size_t size() const { return count_; }
+  size_t memory_bytes() const { return heap_bytes(slots_); }
+
+  /* Each argument is mixed with its position independently of the others
+     (so the loop has no carried multiply and vectorizes), then the sum is
+     finalized once */
+  static size_t hash(size_t p, const size_t* vars, size_t n) {
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ p;
+    for (size_t i = 0; i < n; ++i) {
+      h += ((uint64_t) vars[i] ^ ((i + 1) * 0x9e3779b97f4a7c15ULL)) * 0xff51afd7ed558ccdULL;
+    }
+    h ^= h >> 32;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 29;
+    return (size_t) h;
+  }
+
+  /* index of p(vars) in t or npos if it is not a member */
+  size_t find(const PropTable& t, size_t p, const size_t* vars, size_t n) const {
+    if (slots_.empty()) return npos;
+    size_t mask = slots_.size() - 1;
+    for (size_t i = hash(p, vars, n) & mask; slots_[i] != 0; i = (i + 1) & mask) {
+      size_t id = slots_[i] - 1;
+      if (t.pred(id) == p && t.arity(id) == n && std::equal(vars, vars + n, t.vars(id))) {
+        return id;
+      }
+    }
+    return npos;
+  }
+
+  /* Index every proposition of t */
+  void build(const PropTable& t) {
+    slots_.clear();
+    count_ = 0;
+    size_t n = 16;
+    while (n < 2 * t.size()) n *= 2;
+    slots_.resize(n, 0);
+    for (size_t i = 0; i < t.size(); ++i) {
+      place(t, i);
+    }
+    count_ = t.size();
+  }
+
+  /* Insert proposition id of t (assumes it is not already a member) */
+  void insert(const PropTable& t, size_t id) {
+    if (2 * (count_ + 1) > slots_.size()) {
+      rehash(t, slots_.empty() ? 16 : 2 * slots_.size());
+    }
+    place(t, id);
+    ++count_;
+  }
+
+ private:
+  std::vector<size_t> slots_;
+  size_t count_;
+
+  void place(const PropTable& t, size_t id) {
+    size_t mask = slots_.size() - 1;
+    size_t i = hash(t.pred(id), t.vars(id), t.arity(id)) & mask;
+    while (slots_[i] != 0) i = (i + 1) & mask;
+    slots_[i] = id + 1;
+  }
+
+  void rehash(const PropTable& t, size_t n) {
+    std::vector<size_t> old;
+    old.swap(slots_);
+    slots_.resize(n, 0);
+    for (size_t i = 0; i < old.size(); ++i) {
+      if (old[i] != 0) place(t, old[i] - 1);
+    }
+  }
 };
 
 /* The type of decisions:
@@ -8,69 +8,345 @@
  *****************************************************************************/
 
 #include <vector>
+#include <memory>
+#include <map>
+#include <unordered_map>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <cassert>
 #include "structure.h"
+#include "target.h"
 #include "definitions.h"
 #include "graph.h"
+#include "stats.h"
+#include "symmetry.h"
+#include "precheck.h"
+#include "components.h"
+#include "locality.h"
 
 #ifndef CM_EMBEDDING_H
 #define CM_EMBEDDING_H
 
+/* Optional preprocessing of an embedding instance */
+struct EmbeddingOptions {
+  EmbeddingOptions() : precheck(true), target_symmetry(true), pattern_symmetry(true), lazy_predicates(false),
+    parallel_filter(false), incremental(false), homomorphism(false), decompose(true), memory_budget(0), reorder(false) {}
+  bool precheck;          /* reject instances failing counting arguments before building the graphs */
+  bool target_symmetry;   /* prune interchangeable elements of b after a failed decision */
+  bool pattern_symmetry;  /* prune interchangeable elements of a after a failed decision */
+  bool lazy_predicates;   /* find supports of propositions on demand instead of building the predicate graph */
+  bool parallel_filter;   /* filter all predicates of a round concurrently (with OpenMP) */
+  bool incremental;       /* keep the unfiltered and root graphs so that changes to b can be applied (see update_target) */
+  bool homomorphism;      /* look for a homomorphism instead: elements and tuples of a may share an image */
+  bool decompose;         /* solve the components of a separately first (see solve_components) */
+  size_t memory_budget;   /* bytes the instance may hold (see memory_usage), 0 for no limit: the predicate
+                             graph is dropped for lazy supports if it would not fit, and a search that
+                             outgrows it stops with MEMORY_LIMIT */
+  bool reorder;           /* renumber the elements and propositions of a, and of b unless incremental, for
+                             locality (see locality.h); solution() and assumptions keep the caller's ids */
+};
+
+/* Candidates computed ahead of time, e.g. once for a batch of patterns (see
+   batch.h): for each element of a its candidates in b, and for each
+   proposition of a its candidate propositions of b (those whose arguments
+   are candidates for its arguments), all in increasing order. The
+   propositions may be left empty to have them computed as usual. */
+struct CandidateSets {
+  std::vector<const std::vector<size_t>*> elements;
+  std::vector<const std::vector<size_t>*> propositions;
+};
+
 template <class Element, class Predicate, class Signature>
 class Embedding{
   public:
     typedef Structure<Element, Predicate, Signature> Str;
+    typedef Target<Element, Predicate, Signature> Tgt;
+
+    /* The embedding keeps views of the propositions of a and b, so both structures
+       must outlive it. The target built for b is the embedding's own, and
+       update_target updates it too. */
+    Embedding(const Str& a, const Str& b, const EmbeddingOptions& options = EmbeddingOptions()) :
+      Embedding(a, std::make_shared<const Tgt>(b, options.reorder && !options.incremental), options) {
+      owns_target_ = true;
+    }
+
+    /* Embed a into a preprocessed target; only a-side work is done here, and
+       none of the candidates are recomputed if given (they must be for the
+       same target and options.homomorphism). The rows they point to are
+       read here and again by the searches of the components of a (see
+       solve_components), so they must outlive those; the CandidateSets
+       itself need not. */
+    Embedding(const Str& a, std::shared_ptr<const Tgt> target, const EmbeddingOptions& options = EmbeddingOptions(),
+              const CandidateSets* given = NULL) :
+      u_graph_(a.universe_size(), target->universe_size()),
+      p_graph_(options.lazy_predicates ? 0 : a.props.size(), options.lazy_predicates ? 0 : target->props().size()),
+      a_(&a), target_(target), u_props_(&a.props), v_props_(&target->props()), valid_(true),
+      lazy_(options.lazy_predicates), parallel_(options.parallel_filter), b_symmetry_(NULL), b_symmetry_stale_(false), stamp_(0),
+      options_(options), built_(false), root_saved_(false), root_valid_(false), keep_root_(false), root_current_(false), at_root_(false),
+      components_(pattern_components(a.props, a.universe_size())), over_budget_(false), lazy_fallback_(false), fixed_bytes_(0),
+      given_(given), has_given_rows_(false), interrupted_(false), owns_target_(false) {
+      CandidateSets reordered;
+      if (options.reorder) reorder_pattern(given, reordered);
+      build();
+      if (given_ != NULL) {
+        given_rows_ = *given_;
+        has_given_rows_ = true;
+      }
+      given_ = NULL;
+    }
+
+    /* Get the underlying representation of the universe and predicate matchings
+       (the predicate graph is empty when its supports are found lazily) */
+    Graph& get_universe_graph() { return u_graph_; }
+    const Graph& get_universe_graph() const { return u_graph_; }
+    Graph& get_predicate_graph() { return p_graph_; }
+    const Graph& get_predicate_graph() const { return p_graph_; }
+    /* Labels of the predicate graph: propositions of structure a (u) and b (v).
+       With the reorder option the graphs, these, the pattern and the target
+       refer to renumbered copies of a and b; original_u and original_v give
+       the ids in a and b of their elements, local_u and local_v the reverse. */
+    const PropTable& get_u_props() const { return *u_props_; }
+    const PropTable& get_v_props() const { return *v_props_; }
+    const Str& get_pattern() const { return *a_; }
+    const Tgt& get_target() const { return *target_; }
+    size_t original_u(size_t u) const { return a_order_.empty() ? u : a_order_[u]; }
+    size_t local_u(size_t u) const { return a_rank_.empty() ? u : a_rank_[u]; }
+    size_t original_v(size_t v) const { return target_->original_id(v); }
+    size_t local_v(size_t v) const { return target_->local_id(v); }
+    std::shared_ptr<const Tgt> shared_target() const { return target_; }
+    const EmbeddingOptions& options() const { return options_; }
+    const PatternComponents& components() const { return components_; }
+    /* The candidates given at construction (in the ids of the pattern as
+       reordered), NULL if none or if b changed since */
+    const CandidateSets* given_candidates() const { return has_given_rows_ ? &given_rows_ : NULL; }
+    bool is_valid() const { return valid_; }
+    bool lazy_predicates() const { return lazy_; }
+    bool injective() const { return !options_.homomorphism; }
+
+    /* Did the graphs not fit in the memory budget even with lazy supports?
+       The instance is then left unbuilt and cannot be searched. */
+    bool over_budget() const { return over_budget_; }
+
+    /* Bytes held by the instance (MemoryUsage::total without decisions), in
+       constant time: only the lazy supports grow once the graphs are built */
+    size_t memory_bytes() const { return fixed_bytes_ + residue_bytes(); }
+
+    /* The bytes held by the instance and the structures it refers to */
+    MemoryUsage memory_usage() const {
+      MemoryUsage m;
+      m.universe_graph = u_graph_.memory_bytes();
+      m.predicate_graph = p_graph_.memory_bytes();
+      m.labels = heap_bytes(u_inv_label_) + heap_bytes(u_stamp_) + heap_bytes(v_stamp_) + residue_bytes()
+                 + heap_bytes(a_order_) + heap_bytes(a_rank_);
+      m.saved_graphs = base_u_.memory_bytes() + base_p_.memory_bytes() + root_u_.memory_bytes() + root_p_.memory_bytes();
+      m.pattern = a_->memory_bytes();
+      m.target = target_->memory_bytes();
+      m.lazy_fallback = lazy_fallback_;
+      return m;
+    }
+
+    /* Commit u |-> v in the universe graph, taking v away from the other
+       elements of a unless looking for a homomorphism; false if that leaves
+       one of them without a candidate */
+    bool commit_edge(size_t u, size_t v, std::vector<Graph::VertexPair>& removed) {
+      return commit(u_graph_, u, v, removed);
+    }
+
+    /* Commit every element of a with a single candidate left (see commit_edge);
+       false if some element has none */
+    bool unit_prop(std::vector<Graph::VertexPair>& removed) {
+      if (injective()) {
+        std::vector<size_t> junk;
+        return u_graph_.unit_prop(removed, junk, junk);
+      }
+      for (size_t u = 0; u < u_graph_.uSize(); ++u) {
+        if (u_graph_.uAdj(u).empty()) return false;
+      }
+      return true;
+    }
 
-    Embedding(const Str& a, const Str& b) : u_graph_(a.universe_size(), b.universe_size()), valid_(true) {
-      fill_u_graph(a, b);
+    /* Remember the state after filtering at the root (valid or not) as the
+       starting point for updates that only remove propositions from b, and
+       for restore_root */
+    void save_root(bool valid) {
+      if ((!options_.incremental && !keep_root_) || !built_) return;
+      root_u_ = u_graph_;
+      root_p_ = p_graph_;
+      root_valid_ = valid;
+      root_saved_ = root_current_ = true;
+      account();
+    }
+
+    /* Keep the root state saved from the next filtering at the root on, as
+       the incremental option does, so that searches can return to it */
+    void keep_root() { keep_root_ = true; }
+
+    /* Go back to the saved root state if it is the one of the current b
+       (is_valid() then tells whether it was consistent); false if there is
+       none, and the root must be filtered again */
+    bool restore_root() {
+      if (!root_current_) return false;
+      u_graph_ = root_u_;
+      p_graph_ = root_p_;
+      valid_ = root_valid_;
+      at_root_ = root_valid_;
+      return true;
+    }
+
+    /* The last embedding found is kept (solution()[u] is the image of u, in
+       the ids of a and b; matching() is the same in those of the graphs);
+       with the incremental option, while it is still one after updates to b
+       the next search returns it right away */
+    void save_solution(const std::vector<int>& matching) { solution_ = matching; }
+    bool has_solution() const { return !solution_.empty(); }
+    const std::vector<int>& matching() const { return solution_; }
+    std::vector<int> solution() const {
+      std::vector<int> s(solution_.size());
+      for (size_t u = 0; u < s.size(); ++u) s[u] = original_v(solution_[local_u(u)]);
+      return s;
+    }
+
+    /* Are the graphs the (consistent) filtered root state? Set by whoever
+       filters at the root or restores that state, cleared by decisions. */
+    bool at_root() const { return at_root_; }
+    void set_at_root(bool at_root) { at_root_ = at_root; }
+
+    /* Bring the embedding up to date after b changed by c (as returned by
+       take_changes on b), without rebuilding the graphs. Needs the incremental
+       option. A shared target must have been updated by its owner first (see
+       Target::update), and then every embedding into it; an embedding built
+       from b itself updates its own target here.
 
-      std::vector<prop> propsA, propsB;
-      for (auto mit = a.relations.begin(); mit != a.relations.end(); ++mit) {
-        for (auto sit = mit->second.begin(); sit != mit->second.end(); ++sit) {
-          propsA.emplace_back(mit->first, (*sit));
+       If b only lost propositions it has no new embeddings, so the next search
+       starts from the root state of the last one, less the removed candidates.
+       Otherwise it starts from the unfiltered graphs, which are updated around
+       the elements whose signatures changed and the new propositions. The
+       symmetry classes of b are rebuilt over all of it, but only on the first
+       backtrack after the update (see symmetric_failures). */
+    void update_target(const StructureChanges& c) {
+      /* the target follows b: it was created non-const here, and no other embedding has it */
+      if (owns_target_) std::const_pointer_cast<Tgt>(target_)->update(c);
+      assert(target_->changes_reflected() >= c.serial);
+      v_props_ = &target_->props();
+      residues_.clear();
+      has_given_rows_ = false;
+      given_rows_ = CandidateSets();
+      at_root_ = root_current_ = false;
+      check_solution();
+      if (!built_) {
+        /* rejected before the graphs were complete: start over */
+        u_graph_ = Graph(u_graph_.uSize(), target_->universe_size());
+        p_graph_ = Graph(lazy_ ? 0 : u_props_->size(), lazy_ ? 0 : v_props_->size());
+        u_inv_label_.clear();
+        a_symmetry_ = SymmetryClasses();
+        b_symmetry_ = NULL;
+        b_symmetry_stale_ = false;
+        valid_ = true;
+        over_budget_ = false;
+        build();
+        return;
+      }
+      const Tgt& b = *target_;
+      std::vector<size_t> added;
+      if (c.renumber.empty()) {
+        for (size_t q = c.size; q < v_props_->size(); ++q) added.push_back(q);
+      } else {
+        std::vector<char> old(v_props_->size(), 0);
+        for (size_t i = 0; i < c.renumber.size(); ++i) {
+          if (c.renumber[i] != TupleSet::npos) old[c.renumber[i]] = 1;
+        }
+        for (size_t q = 0; q < old.size(); ++q) {
+          if (!old[q]) added.push_back(q);
         }
       }
+      bool grew = b.universe_size() > c.universe_size || !added.empty();
+      bool from_root = root_saved_ && !grew;
+      if (grew) root_saved_ = false;
 
-      for (auto mit = b.relations.begin(); mit != b.relations.end(); ++mit) {
-        for (auto sit = mit->second.begin(); sit != mit->second.end(); ++sit) {
-          propsB.emplace_back(mit->first, (*sit));
+      base_u_.grow(u_graph_.uSize(), b.universe_size());
+      base_p_.grow(base_p_.uSize(), lazy_ ? 0 : v_props_->size());
+      if (!c.renumber.empty() && !lazy_) {
+        renumber_targets(base_p_, c.renumber);
+        if (from_root) renumber_targets(root_p_, c.renumber);
+      }
+
+      /* candidates of the changed elements */
+      std::vector<size_t> changed(c.touched);
+      for (size_t y = c.universe_size; y < b.universe_size(); ++y) changed.push_back(y);
+      std::sort(changed.begin(), changed.end());
+      changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+      std::vector<Graph::VertexPair> added_u, removed_u;
+      std::vector<char> had(u_graph_.uSize(), 0);
+      for (size_t i = 0; i < changed.size(); ++i) {
+        size_t y = changed[i];
+        const std::vector<Graph::Edge>& y_adj = base_u_.vAdj(y);
+        for (size_t j = 0; j < y_adj.size(); ++j) had[y_adj[j].vertex] = 1;
+        for (size_t x = 0; x < had.size(); ++x) {
+          bool candidate = below(a_->get_signature(x), b.structure().get_signature(y));
+          if (candidate && !had[x]) {
+            base_u_.add_edge(x, y);
+            added_u.emplace_back(x, y);
+          } else if (!candidate && had[x]) {
+            base_u_.remove_if_present(x, y);
+            removed_u.emplace_back(x, y);
+            if (from_root) root_u_.remove_if_present(x, y);
+          }
+          had[x] = 0;
         }
       }
+      if (!lazy_) update_base_p(added_u, removed_u, added);
 
-      p_graph_ = std::move(LabeledGraph<prop, prop>(std::move(propsA), std::move(propsB)));
-      fill_p_graph();
-      fill_inv_label();
+      u_graph_ = from_root ? root_u_ : base_u_;
+      p_graph_ = from_root ? root_p_ : base_p_;
+      u_graph_.grow(u_graph_.uSize(), b.universe_size());
+      valid_ = from_root ? root_valid_ : true;
+      if (valid_ && options_.precheck && injective() && !precheck(*a_, b)) valid_ = false;
+      b_symmetry_stale_ = b_symmetry_ != NULL;
+      if (!v_stamp_.empty()) v_stamp_.resize(b.universe_size(), 0);
+      account();
     }
 
-    /* Get the underlying representation of the universe and predicate matchings */
-    Graph& get_universe_graph() { return u_graph_; }
-    const Graph& get_universe_graph() const { return u_graph_; }
-    LabeledGraph<prop, prop>& get_predicate_graph() { return p_graph_; }
-    const LabeledGraph<prop, prop>& get_predicate_graph() const { return p_graph_; }
-    bool is_valid() const { return valid_; }
-
-    /* Commit to a decision and ensure arc consistency. */
-    void decide(decision& d) {
-      if (!u_graph_.commit_edge(d.u, d.v, d.remove_u)) {
+    /* Commit to a decision and ensure arc consistency. Without fixpoint only the
+       predicates mentioning d.u are filtered. */
+    void decide(decision& d, bool fixpoint = true) {
+      CM_COUNT(decisions);
+      at_root_ = false;
+      if (!commit(u_graph_, d.u, d.v, d.remove_u)) {
         valid_ = false;
       } else {
         const std::vector<Graph::Edge>& preds = u_inv_label_[d.u];
         // start filtering likely candidates to avoid expensive filter rounds
         for (size_t i = 0; i < preds.size(); ++i) {
           size_t p = preds[i].vertex;
-          filter_one(p, d.remove_u, d.remove_p);
+          if (lazy_) filter_one_lazy(p, d.remove_u);
+          else filter_one(p, d.remove_u, d.remove_p);
           if (!valid_) return;
         }
-        filter(d.remove_u, d.remove_p);
+        if (fixpoint) filter(d.remove_u, d.remove_p);
       }
     }
 
+    /* Check interrupt as filtering goes, with true at the start of each
+       round and false between the propositions of a round of the serial
+       filter: once it returns true the filter stops short of arc
+       consistency and interrupted() is set. An empty function (the
+       default) never interrupts. */
+    void set_interrupt(const std::function<bool(bool)>& interrupt) {
+      interrupt_ = interrupt;
+      interrupted_ = false;
+    }
+    bool interrupted() const { return interrupted_; }
+
     /* Filter the graph to achieve arc consistency */
     bool filter(std::vector<Graph::VertexPair>& remove_u, std::vector<Graph::VertexPair>& remove_p) {
+      if (parallel_) return filter_parallel(remove_u, remove_p);
       bool filtered = true; // more filtering to do?
       while (valid_ && filtered) {
         filtered = false;
-        for (size_t p = 0; p < p_graph_.uSize(); ++p) {
-          if (filter_one(p, remove_u, remove_p)) {
+        for (size_t p = 0; p < u_props_->size(); ++p) {
+          if (stop_round(p == 0)) return true;
+          if (lazy_ ? filter_one_lazy(p, remove_u) : filter_one(p, remove_u, remove_p)) {
             filtered = true;
           }
           if (!valid_) {
@@ -81,6 +357,33 @@ class Embedding{
       return true;
     }
 
+    /* The decision u |-> v has failed in the current state. Collect the edges that
+       fail for the same reason: (u, w) for w interchangeable with v in b and
+       (y, v) for y interchangeable with u in a, whenever swapping them leaves
+       the universe graph unchanged. */
+    void symmetric_failures(size_t u, size_t v, std::vector<Graph::VertexPair>& failed) {
+      if (b_symmetry_stale_) {
+        b_symmetry_ = &target_->symmetries();
+        b_symmetry_stale_ = false;
+      }
+      if (b_symmetry_ != NULL) {
+        const std::vector<size_t>& vs = b_symmetry_->members(b_symmetry_->class_of(v));
+        for (size_t i = 0; vs.size() > 1 && i < vs.size(); ++i) {
+          if (vs[i] != v && u_graph_.has_edge(u, vs[i]) && same_adjacency(u_stamp_, u_graph_.vAdj(v), u_graph_.vAdj(vs[i]))) {
+            failed.emplace_back(u, vs[i]);
+          }
+        }
+      }
+      if (a_symmetry_.num_classes() != 0) {
+        const std::vector<size_t>& us = a_symmetry_.members(a_symmetry_.class_of(u));
+        for (size_t i = 0; us.size() > 1 && i < us.size(); ++i) {
+          if (us[i] != u && u_graph_.has_edge(us[i], v) && same_adjacency(v_stamp_, u_graph_.uAdj(u), u_graph_.uAdj(us[i]))) {
+            failed.emplace_back(us[i], v);
+          }
+        }
+      }
+    }
+
     /* Add edges back to the predicate and universe graph (and assume the graph is valid) */
     void add_back(const std::vector<Graph::VertexPair>& p_edges, const std::vector<Graph::VertexPair>& u_edges) {
       valid_ = true;
@@ -94,31 +397,271 @@ class Embedding{
 
   private:
     Graph u_graph_;
-    LabeledGraph<prop, prop> p_graph_;
-    /* (vert, pos) \in u_inv_label_[u] -> p_graph_.getULabel(vert).vars[pos] = u */
+    Graph p_graph_;
+    const Str* a_;
+    std::shared_ptr<const Tgt> target_;
+    const PropTable* u_props_;
+    const PropTable* v_props_;
+    /* (vert, pos) \in u_inv_label_[u] -> u_props_->vars(vert)[pos] = u */
     std::vector<std::vector<Graph::Edge>> u_inv_label_;
-    /* (vert, pos) \in u_inv_label_[v] -> p_graph_.getULabel(vert).vars[pos] = v */
-    std::vector<std::vector<Graph::Edge>> v_inv_label_;
     bool valid_;
+    bool lazy_;
+    bool parallel_;
+    /* lazy supports: the proposition of b that last supported x |-> y at argument
+       slot s of a (s = u_props_->offsets()[p] + pos), keyed by s * |B| + y */
+    std::unordered_map<uint64_t, size_t> residues_;
+    const SymmetryClasses* b_symmetry_;   /* NULL unless target symmetries are used */
+    bool b_symmetry_stale_;               /* b changed since b_symmetry_ was fetched (see update_target) */
+    SymmetryClasses a_symmetry_;          /* empty unless pattern symmetries are used */
+    /* scratch marks for comparing adjacency lists: entries equal to stamp_ are marked */
+    std::vector<size_t> u_stamp_, v_stamp_;
+    size_t stamp_;
+    EmbeddingOptions options_;
+    bool built_;        /* were the graphs completed (and, if incremental, saved)? */
+    /* with the incremental option: the graphs before any filtering and after
+       filtering at the root of the last search (also kept with keep_root) */
+    Graph base_u_, base_p_, root_u_, root_p_;
+    bool root_saved_;
+    bool root_valid_;
+    bool keep_root_;
+    bool root_current_;   /* root_u_ and root_p_ are the filtered root state of the current b */
+    std::vector<int> solution_;   /* last embedding found */
+    bool at_root_;
+    PatternComponents components_;
+    bool over_budget_;
+    bool lazy_fallback_;   /* lazy supports were switched to for the budget */
+    size_t fixed_bytes_;   /* memory_bytes less the lazy supports, as of the last account() */
+    const CandidateSets* given_;   /* while constructing, if candidates were given */
+    CandidateSets given_rows_;     /* kept for the searches of the components (see given_candidates) */
+    bool has_given_rows_;
+    std::function<bool(bool)> interrupt_;
+    bool interrupted_;
+    bool owns_target_;   /* was the target built here for b (see update_target)? */
+
+    /* Stop filtering here? */
+    bool stop_round(bool round) {
+      if (!interrupt_ || !interrupt_(round)) return false;
+      interrupted_ = true;
+      return true;
+    }
+    std::shared_ptr<const Str> local_a_;   /* a renumbered, with the reorder option (shared by copies) */
+    std::vector<size_t> a_order_;          /* original id of each element of local_a_, empty unless reordered */
+    std::vector<size_t> a_rank_;           /* inverse of a_order_ */
+
+    /* Work on a copy of a renumbered for locality from here on; the given
+       candidates are permuted into reordered to match it */
+    void reorder_pattern(const CandidateSets* given, CandidateSets& reordered) {
+      std::vector<size_t> prop_order;
+      a_order_ = locality_order(a_->propositions(), a_->universe_size());
+      local_a_ = std::make_shared<const Str>(renumbered(*a_, a_order_, prop_order));
+      a_rank_.resize(a_order_.size());
+      for (size_t u = 0; u < a_order_.size(); ++u) a_rank_[a_order_[u]] = u;
+      a_ = local_a_.get();
+      u_props_ = &a_->propositions();
+      components_ = pattern_components(*u_props_, a_->universe_size());
+      if (given == NULL) return;
+      for (size_t u = 0; u < a_order_.size(); ++u) reordered.elements.push_back(given->elements[a_order_[u]]);
+      for (size_t p = 0; p < prop_order.size() && !given->propositions.empty(); ++p) {
+        reordered.propositions.push_back(given->propositions[prop_order[p]]);
+      }
+      given_ = &reordered;
+    }
+
+    /* Drop the saved embedding unless b still has the image of every proposition of a */
+    void check_solution() {
+      std::vector<size_t> image;
+      for (size_t p = 0; p < u_props_->size() && !solution_.empty(); ++p) {
+        const size_t* u_vars = u_props_->vars(p);
+        image.resize(u_props_->arity(p));
+        for (size_t k = 0; k < image.size(); ++k) image[k] = solution_[u_vars[k]];
+        if (target_->tuples().find(*v_props_, u_props_->pred(p), image.data(), image.size()) == TupleSet::npos) {
+          solution_.clear();
+        }
+      }
+    }
+
+    void build() {
+      if (options_.precheck && injective() && !precheck(*a_, *target_)) {
+        valid_ = false;
+        return;
+      }
+      {
+        CM_TIME_PHASE(PHASE_FILL_U_GRAPH);
+        fill_u_graph(*a_);
+        if (options_.precheck && valid_ && injective()) check_hall();
+      }
+      if (!within_budget(u_graph_.memory_bytes() * copies())) return;
+      {
+        CM_TIME_PHASE(PHASE_FILL_P_GRAPH);
+        if (!lazy_) fill_p_graph();
+        fill_inv_label();
+      }
+      if (!valid_) return;
+      fill_symmetries(options_);
+      if (options_.incremental) {
+        base_u_ = u_graph_;
+        base_p_ = p_graph_;
+      }
+      account();
+      if (!within_budget(memory_bytes())) return;
+      built_ = true;
+    }
 
-    /* Takes 2 structures and constructs universe graph */
-    void fill_u_graph(const Str& a, const Str& b) {
+    /* Copies of the graphs held: the incremental option keeps the unfiltered
+       and root graphs besides the working ones, keep_root the root ones */
+    size_t copies() const { return options_.incremental ? 3 : keep_root_ ? 2 : 1; }
+
+    /* Check that bytes fit in the budget, marking the instance over budget if not */
+    bool within_budget(size_t bytes) {
+      if (options_.memory_budget == 0 || bytes <= options_.memory_budget) return true;
+      over_budget_ = true;
+      return false;
+    }
+
+    /* Recompute fixed_bytes_ after the graphs were built or replaced */
+    void account() {
+      MemoryUsage m = memory_usage();
+      fixed_bytes_ = m.total() - residue_bytes();
+    }
+
+    /* Bytes held by the lazy supports (nodes and buckets of the hash map) */
+    size_t residue_bytes() const {
+      return residues_.size() * (sizeof(std::pair<const uint64_t, size_t>) + sizeof(void*)) + residues_.bucket_count() * sizeof(void*);
+    }
+
+    /* Relabel the b side of a predicate graph after propositions of b were removed */
+    void renumber_targets(Graph& g, const std::vector<size_t>& renumber) const {
+      Graph h(g.uSize(), v_props_->size());
+      for (size_t p = 0; p < g.uSize(); ++p) {
+        const std::vector<Graph::Edge>& adj = g.uAdj(p);
+        for (size_t j = 0; j < adj.size(); ++j) {
+          if (renumber[adj[j].vertex] != TupleSet::npos) h.add_edge(p, renumber[adj[j].vertex]);
+        }
+      }
+      g = h;
+    }
+
+    /* Are all arguments of q candidates for those of p in g? */
+    bool candidate_in(const Graph& g, size_t p, size_t q) const {
+      size_t arity = u_props_->arity(p);
+      if (v_props_->arity(q) != arity) return false;
+      const size_t* p_vars = u_props_->vars(p);
+      const size_t* q_vars = v_props_->vars(q);
+      for (size_t k = 0; k < arity; ++k) {
+        if (!g.has_edge(p_vars[k], q_vars[k])) return false;
+      }
+      return true;
+    }
+
+    /* Update the unfiltered predicate graph for universe edges that were added
+       and removed and for new propositions of b */
+    void update_base_p(const std::vector<Graph::VertexPair>& added_u, const std::vector<Graph::VertexPair>& removed_u,
+                       const std::vector<size_t>& added) {
+      const Tgt& b = *target_;
+      for (size_t i = 0; i < removed_u.size(); ++i) {
+        const std::vector<Graph::Edge>& preds = u_inv_label_[removed_u[i].u];
+        for (size_t j = 0; j < preds.size(); ++j) {
+          std::pair<const Graph::Edge*, const Graph::Edge*> qs = b.occurrences(removed_u[i].v, u_props_->pred(preds[j].vertex), preds[j].position);
+          for (const Graph::Edge* q = qs.first; q != qs.second; ++q) base_p_.remove_if_present(preds[j].vertex, q->vertex);
+        }
+      }
+      for (size_t i = 0; i < added_u.size(); ++i) {
+        const std::vector<Graph::Edge>& preds = u_inv_label_[added_u[i].u];
+        for (size_t j = 0; j < preds.size(); ++j) {
+          size_t p = preds[j].vertex;
+          std::pair<const Graph::Edge*, const Graph::Edge*> qs = b.occurrences(added_u[i].v, u_props_->pred(p), preds[j].position);
+          for (const Graph::Edge* q = qs.first; q != qs.second; ++q) {
+            if (candidate_in(base_u_, p, q->vertex) && !base_p_.has_edge(p, q->vertex)) base_p_.add_edge(p, q->vertex);
+          }
+        }
+      }
+      if (added.empty()) return;
+      std::map<size_t, std::vector<size_t>> by_pred;
+      for (size_t p = 0; p < u_props_->size(); ++p) by_pred[u_props_->pred(p)].push_back(p);
+      for (size_t i = 0; i < added.size(); ++i) {
+        std::map<size_t, std::vector<size_t>>::const_iterator it = by_pred.find(v_props_->pred(added[i]));
+        if (it == by_pred.end()) continue;
+        for (size_t j = 0; j < it->second.size(); ++j) {
+          size_t p = it->second[j];
+          if (candidate_in(base_u_, p, added[i]) && !base_p_.has_edge(p, added[i])) base_p_.add_edge(p, added[i]);
+        }
+      }
+    }
+
+    /* Every element of a needs its own candidate: the universe graph must have
+       a total matching (Hall's condition) */
+    void check_hall() {
+      std::vector<int> match1(u_graph_.uSize(), -1), match2(u_graph_.vSize(), -1), vis(u_graph_.uSize(), 0);
+      if (u_graph_.max_matching(match1, match2, vis) != u_graph_.uSize()) {
+        valid_ = false;
+      }
+    }
+
+    void fill_symmetries(const EmbeddingOptions& options) {
+      CM_TIME_PHASE(PHASE_SIGNATURES);
+      if (options.target_symmetry) {
+        b_symmetry_ = &target_->symmetries();
+        u_stamp_.resize(u_graph_.uSize(), 0);
+      }
+      if (options.pattern_symmetry) {
+        /* elements occurring at different (predicate, position) pairs are never interchangeable */
+        std::map<std::vector<std::pair<size_t, size_t>>, std::vector<size_t>> buckets;
+        for (size_t u = 0; u < u_inv_label_.size(); ++u) {
+          std::vector<std::pair<size_t, size_t>> key;
+          for (size_t i = 0; i < u_inv_label_[u].size(); ++i) {
+            key.emplace_back(u_props_->pred(u_inv_label_[u][i].vertex), u_inv_label_[u][i].position);
+          }
+          std::sort(key.begin(), key.end());
+          buckets[key].push_back(u);
+        }
+        std::vector<std::vector<size_t>> partition;
+        for (auto it = buckets.begin(); it != buckets.end(); ++it) partition.push_back(it->second);
+        a_symmetry_.build(*u_props_, u_inv_label_, partition);
+        v_stamp_.resize(u_graph_.vSize(), 0);
+      }
+    }
+
+    /* Are the adjacency lists x and y equal as sets? (marks is indexed by their vertices) */
+    bool same_adjacency(std::vector<size_t>& marks, const std::vector<Graph::Edge>& x, const std::vector<Graph::Edge>& y) {
+      if (x.size() != y.size()) return false;
+      ++stamp_;
+      for (size_t i = 0; i < x.size(); ++i) marks[x[i].vertex] = stamp_;
+      for (size_t i = 0; i < y.size(); ++i) {
+        if (marks[y[i].vertex] != stamp_) return false;
+      }
+      return true;
+    }
+
+    /* Can an element with signature x map to one with signature y? */
+    bool below(const Signature& x, const Signature& y) const {
+      return injective() ? x <= y : x.occurs_within(y);
+    }
+
+    /* Commit u |-> v in g (the universe or predicate graph), keeping v a
+       choice for the others when looking for a homomorphism */
+    bool commit(Graph& g, size_t u, size_t v, std::vector<Graph::VertexPair>& removed) {
+      if (injective()) return g.commit_edge(u, v, removed);
+      g.keep_edge(u, v, removed);
+      return true;
+    }
+
+    /* Constructs the universe graph: a |-> b whenever the signature of a is
+       below the signature of b (tested once per class of equal signatures in b) */
+    void fill_u_graph(const Str& a) {
+      const Tgt& b = *target_;
       std::vector<std::vector<size_t>> adj;
-      adj.resize(a.universe_size());
+      adj.resize(given_ != NULL ? 0 : a.universe_size());
 
       /* use adj as placeholder in order to safely parallelize */
       #pragma omp parallel for schedule(guided)
-      for (size_t i = 0; i < a.universe_size(); ++i) {
-        for (size_t j = 0; j < b.universe_size(); ++j) {
-          if (a.get_signature(i) <= b.get_signature(j)) {
-            adj[i].push_back(j);
-          }
-        }
+      for (size_t i = 0; i < adj.size(); ++i) {
+        adj[i] = b.candidates(a.get_signature(i), !injective());
       }
       /* Add (undirected) edges to universe graph */
-      for (size_t i = 0; i < adj.size(); ++i) {
-        for (size_t j = 0; j < adj[i].size(); ++j) {
-          u_graph_.add_edge(i, adj[i][j]);
+      for (size_t i = 0; i < a.universe_size(); ++i) {
+        const std::vector<size_t>& candidates = given_ != NULL ? *given_->elements[i] : adj[i];
+        for (size_t j = 0; j < candidates.size(); ++j) {
+          u_graph_.add_edge(i, candidates[j]);
         }
       }
 
@@ -129,18 +672,43 @@ class Embedding{
       }
     }
 
-    /* finish constructing the predicate graph */
+    /* finish constructing the predicate graph, or switch to lazy supports
+       when it would not fit in the memory budget */
     void fill_p_graph() {
       if (!valid_) return;
-      for (size_t i = 0; i < p_graph_.uSize(); ++i) {
-        const prop& u_label = p_graph_.getULabel(i);
-        for (size_t j = 0; j < p_graph_.vSize(); ++j) {
-          const prop& v_label = p_graph_.getVLabel(j);
-          bool mem(u_label.pred == v_label.pred);
-          for (size_t k = 0; mem && k < u_label.vars.size(); ++k) {
-            mem = u_graph_.has_edge(u_label.vars[k], v_label.vars[k]);
+      const PropTable& u_props = *u_props_;
+      const PropTable& v_props = *v_props_;
+      /* bytes held by the universe graphs, and by the predicate graphs (projected from their edges) */
+      size_t held = u_graph_.memory_bytes() * copies();
+      size_t edges = 0;
+      for (size_t i = 0; i < u_props.size(); ++i) {
+        if (options_.memory_budget != 0 &&
+            held + (p_graph_.uSize() + p_graph_.vSize()) * sizeof(std::vector<Graph::Edge>) + 2 * edges * sizeof(Graph::Edge) * copies() > options_.memory_budget) {
+          p_graph_ = Graph();
+          lazy_ = true;
+          lazy_fallback_ = true;
+          return;
+        }
+        if (given_ != NULL && !given_->propositions.empty()) {
+          const std::vector<size_t>& row = *given_->propositions[i];
+          for (size_t c = 0; c < row.size(); ++c) p_graph_.add_edge(i, row[c]);
+          edges += row.size();
+          continue;
+        }
+        const size_t* u_vars = u_props.vars(i);
+        size_t arity = u_props.arity(i);
+        const std::vector<size_t>& candidates = target_->pred_props(u_props.pred(i));
+        for (size_t c = 0; c < candidates.size(); ++c) {
+          size_t j = candidates[c];
+          const size_t* v_vars = v_props.vars(j);
+          bool mem(arity == v_props.arity(j));
+          for (size_t k = 0; mem && k < arity; ++k) {
+            mem = u_graph_.has_edge(u_vars[k], v_vars[k]);
+          }
+          if (mem) {
+            p_graph_.add_edge(i, j);
+            ++edges;
           }
-          if (mem) p_graph_.add_edge(i, j);
         }
       }
 
@@ -156,35 +724,29 @@ class Embedding{
     void fill_inv_label() {
       if (!valid_) return;
       u_inv_label_.resize(u_graph_.uSize());
-      for (size_t i = 0; i < p_graph_.uSize(); ++i){
-        const std::vector<size_t>& vars = p_graph_.getULabel(i).vars;
-        for (size_t k = 0; k < vars.size(); ++k){
+      for (size_t i = 0; i < u_props_->size(); ++i){
+        const size_t* vars = u_props_->vars(i);
+        for (size_t k = 0; k < u_props_->arity(i); ++k){
           u_inv_label_[vars[k]].emplace_back(i, k);
         }
       }
-
-      v_inv_label_.resize(u_graph_.vSize());
-      for (size_t i = 0; i < p_graph_.vSize(); ++i){
-        const std::vector<size_t>& vars = p_graph_.getVLabel(i).vars;
-        for (size_t k = 0; k < vars.size(); ++k){
-          v_inv_label_[vars[k]].emplace_back(i, k);
-        }
-      }
     }
 
     /* Filter one predicate p(x0, ..., xn) one iteration */
     bool filter_one(size_t p, std::vector<Graph::VertexPair>& remove_u, std::vector<Graph::VertexPair>& remove_p) {
       const std::vector<Graph::Edge>& p_adj = p_graph_.uAdj(p);
-      const std::vector<size_t>& p_vars = p_graph_.getULabel(p).vars;
+      const size_t* p_vars = u_props_->vars(p);
+      size_t arity = u_props_->arity(p);
       /* For each edge p(x_1,...,x_n) -> q(y_1, ..., y_n) in the
          predicate graph, ensure that each of x_1 -> y_1, ..., x_n ->
          y_n is the universe graph. */
       size_t q = 0;
       bool filtered = false;
+      CM_COUNT(filter_calls);
       while (q < p_adj.size()) {
-        const std::vector<size_t>& q_vars = p_graph_.getVLabel(p_adj[q].vertex).vars;
+        const size_t* q_vars = v_props_->vars(p_adj[q].vertex);
         bool remove_pq = false;
-        for (size_t i = 0; !remove_pq && i < p_vars.size(); ++i) {
+        for (size_t i = 0; !remove_pq && i < arity; ++i) {
           const std::vector<Graph::Edge>& u_adj = u_graph_.uAdj(p_vars[i]);
           size_t v;
           for (v = 0; v < u_adj.size() && u_adj[v].vertex != q_vars[i]; ++v);
@@ -204,13 +766,14 @@ class Embedding{
         valid_ = false;
         return true;
       } else if (q == 1) { // unit prop
-        if (!p_graph_.commit_edge(p, p_adj[0].vertex, remove_p)) {
+        CM_COUNT(unit_props);
+        if (!commit(p_graph_, p, p_adj[0].vertex, remove_p)) {
           valid_ = false;
           return true;
         }
-        const std::vector<size_t>& q_vars = p_graph_.getVLabel(p_adj[0].vertex).vars;
-        for (size_t i = 0; i < p_vars.size(); ++i) {
-          if (!u_graph_.commit_edge(p_vars[i], q_vars[i], remove_u)) {
+        const size_t* q_vars = v_props_->vars(p_adj[0].vertex);
+        for (size_t i = 0; i < arity; ++i) {
+          if (!commit(u_graph_, p_vars[i], q_vars[i], remove_u)) {
             valid_ = false;
             return true;
           }
@@ -218,13 +781,13 @@ class Embedding{
       } else {
         /* Suppose that x_i -> y.  Then there must be some p(x_1,...,x_n) ->
            q(y_1, ..., y_n) in the predicate graph with y = y_i */
-        for (size_t i = 0; i < p_vars.size(); ++i) {
+        for (size_t i = 0; i < arity; ++i) {
           const std::vector<Graph::Edge>& xi_adj = u_graph_.uAdj(p_vars[i]);
           size_t y = 0;
           while (y < xi_adj.size()) {
             bool remove_xiy = true;
             for (size_t q = 0; remove_xiy && q < p_adj.size(); ++q) {
-              const std::vector<size_t>& q_vars = p_graph_.getVLabel(p_adj[q].vertex).vars;
+              const size_t* q_vars = v_props_->vars(p_adj[q].vertex);
               if (xi_adj[y].vertex == q_vars[i]) {
                 remove_xiy = false;
               }
@@ -241,7 +804,8 @@ class Embedding{
             valid_ = false;
             return true;
           } else if (y == 1) { // unit prop
-            if (!u_graph_.commit_edge(p_vars[i], xi_adj[0].vertex, remove_u)) {
+            CM_COUNT(unit_props);
+            if (!commit(u_graph_, p_vars[i], xi_adj[0].vertex, remove_u)) {
               valid_ = false;
               return true;
             }
@@ -251,6 +815,187 @@ class Embedding{
       return filtered;
     }
 
+    /* Does b have a nullary proposition with relation symbol q? */
+    bool has_nullary(size_t q) const {
+      const std::vector<size_t>& candidates = target_->pred_props(q);
+      for (size_t c = 0; c < candidates.size(); ++c) {
+        if (v_props_->arity(candidates[c]) == 0) return true;
+      }
+      return false;
+    }
+
+    /* Is some proposition of b with x_pos |-> y a candidate for p(x_1, ..., x_n)
+       under the current universe graph? The last support found is tried first. */
+    bool has_support(size_t p, size_t pos, size_t y) {
+      size_t q;
+      if (!find_support(p, pos, y, q)) return false;
+      if (q != RESIDUE) residues_[residue_key(p, pos, y)] = q;
+      return true;
+    }
+
+    static const size_t RESIDUE = (size_t) -1;
+
+    uint64_t residue_key(size_t p, size_t pos, size_t y) const {
+      return (uint64_t) (u_props_->offsets()[p] + pos) * u_graph_.vSize() + y;
+    }
+
+    /* Look for a support of x_pos |-> y without updating the residues: q is
+       the support found, or RESIDUE if the cached one still holds */
+    bool find_support(size_t p, size_t pos, size_t y, size_t& q) const {
+      const size_t* p_vars = u_props_->vars(p);
+      size_t arity = u_props_->arity(p);
+      std::unordered_map<uint64_t, size_t>::const_iterator residue = residues_.find(residue_key(p, pos, y));
+      if (residue != residues_.end() && supports(p_vars, arity, pos, residue->second)) {
+        q = RESIDUE;
+        return true;
+      }
+      std::pair<const Graph::Edge*, const Graph::Edge*> qs = target_->occurrences(y, u_props_->pred(p), pos);
+      for (const Graph::Edge* it = qs.first; it != qs.second; ++it) {
+        if (v_props_->arity(it->vertex) == arity && supports(p_vars, arity, pos, it->vertex)) {
+          q = it->vertex;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    /* Is every argument of proposition q of b (except pos, known to be; pos = arity
+       checks them all) a candidate for the one of p_vars? */
+    bool supports(const size_t* p_vars, size_t arity, size_t pos, size_t q) const {
+      const size_t* q_vars = v_props_->vars(q);
+      for (size_t k = 0; k < arity; ++k) {
+        if (k != pos && !u_graph_.has_edge(p_vars[k], q_vars[k])) return false;
+      }
+      return true;
+    }
+
+    /* Filter one predicate p(x0, ..., xn) one iteration without the predicate
+       graph: x_i -> y is kept iff a proposition of b with y at position i has
+       all of its arguments in the universe graph */
+    bool filter_one_lazy(size_t p, std::vector<Graph::VertexPair>& remove_u) {
+      const size_t* p_vars = u_props_->vars(p);
+      size_t arity = u_props_->arity(p);
+      bool filtered = false;
+      CM_COUNT(filter_calls);
+      if (arity == 0) {
+        if (!has_nullary(u_props_->pred(p))) valid_ = false;
+        return !valid_;
+      }
+      for (size_t i = 0; i < arity; ++i) {
+        const std::vector<Graph::Edge>& xi_adj = u_graph_.uAdj(p_vars[i]);
+        size_t y = 0;
+        while (y < xi_adj.size()) {
+          if (has_support(p, i, xi_adj[y].vertex)) {
+            ++y;
+          } else {
+            remove_u.emplace_back(p_vars[i], xi_adj[y].vertex);
+            u_graph_.remove_edge(p_vars[i], y);
+            filtered = true;
+          }
+        }
+        if (y == 0) {
+          valid_ = false;
+          return true;
+        } else if (y == 1) { // unit prop
+          CM_COUNT(unit_props);
+          if (!commit(u_graph_, p_vars[i], xi_adj[0].vertex, remove_u)) {
+            valid_ = false;
+            return true;
+          }
+        }
+      }
+      return filtered;
+    }
+
+
+    /* What filtering p would remove from the current graphs, found without
+       changing them: predicate edges with a missing argument (dead_p),
+       universe edges without a support (dead_u) and new residues. marks is
+       scratch indexed by the elements of b. Returns false if p has no
+       support at all. */
+    bool unsupported(size_t p, std::vector<size_t>& marks, size_t& stamp, std::vector<Graph::VertexPair>& dead_u,
+                     std::vector<Graph::VertexPair>& dead_p, std::vector<std::pair<uint64_t, size_t>>& found) const {
+      const size_t* p_vars = u_props_->vars(p);
+      size_t arity = u_props_->arity(p);
+      if (lazy_) {
+        if (arity == 0) return has_nullary(u_props_->pred(p));
+        for (size_t i = 0; i < arity; ++i) {
+          const std::vector<Graph::Edge>& xi_adj = u_graph_.uAdj(p_vars[i]);
+          for (size_t y = 0; y < xi_adj.size(); ++y) {
+            size_t q;
+            if (!find_support(p, i, xi_adj[y].vertex, q)) dead_u.emplace_back(p_vars[i], xi_adj[y].vertex);
+            else if (q != RESIDUE) found.emplace_back(residue_key(p, i, xi_adj[y].vertex), q);
+          }
+        }
+        return true;
+      }
+      const std::vector<Graph::Edge>& p_adj = p_graph_.uAdj(p);
+      std::vector<size_t> alive;
+      for (size_t q = 0; q < p_adj.size(); ++q) {
+        if (supports(p_vars, arity, arity, p_adj[q].vertex)) alive.push_back(p_adj[q].vertex);
+        else dead_p.emplace_back(p, p_adj[q].vertex);
+      }
+      if (alive.empty()) return false;
+      /* x_i -> y needs a live q(y_1, ..., y_n) with y = y_i */
+      for (size_t i = 0; i < arity; ++i) {
+        ++stamp;
+        for (size_t q = 0; q < alive.size(); ++q) marks[v_props_->vars(alive[q])[i]] = stamp;
+        const std::vector<Graph::Edge>& xi_adj = u_graph_.uAdj(p_vars[i]);
+        for (size_t y = 0; y < xi_adj.size(); ++y) {
+          if (marks[xi_adj[y].vertex] != stamp) dead_u.emplace_back(p_vars[i], xi_adj[y].vertex);
+        }
+      }
+      return true;
+    }
+
+    /* Filter to the same fixpoint as filter, in rounds: every predicate finds
+       what it would remove from a snapshot of the graphs concurrently, then
+       the removals are applied (in predicate order, so the result does not
+       depend on the number of threads) and propagated as unit choices. */
+    bool filter_parallel(std::vector<Graph::VertexPair>& remove_u, std::vector<Graph::VertexPair>& remove_p) {
+      size_t n = u_props_->size();
+      std::vector<std::vector<Graph::VertexPair>> dead_u(n), dead_p(n);
+      std::vector<std::vector<std::pair<uint64_t, size_t>>> found(n);
+      std::vector<char> wiped(n);
+      std::vector<size_t> junk;
+      while (valid_) {
+        if (stop_round(true)) return true;
+        #pragma omp parallel
+        {
+          std::vector<size_t> marks(lazy_ ? 0 : u_graph_.vSize(), 0);
+          size_t stamp = 0;
+          #pragma omp for schedule(guided)
+          for (size_t p = 0; p < n; ++p) {
+            dead_u[p].clear();
+            dead_p[p].clear();
+            found[p].clear();
+            wiped[p] = !unsupported(p, marks, stamp, dead_u[p], dead_p[p], found[p]);
+          }
+        }
+        CM_COUNT_N(filter_calls, n);
+        size_t removed = remove_u.size() + remove_p.size();
+        for (size_t p = 0; p < n; ++p) {
+          if (wiped[p]) {
+            valid_ = false;
+            return false;
+          }
+          for (size_t i = 0; i < dead_p[p].size(); ++i) {
+            p_graph_.remove_if_present(dead_p[p][i].u, dead_p[p][i].v);
+            remove_p.push_back(dead_p[p][i]);
+          }
+          for (size_t i = 0; i < dead_u[p].size(); ++i) {
+            if (u_graph_.remove_if_present(dead_u[p][i].u, dead_u[p][i].v)) remove_u.push_back(dead_u[p][i]);
+          }
+          for (size_t i = 0; i < found[p].size(); ++i) residues_[found[p][i].first] = found[p][i].second;
+        }
+        if (remove_u.size() + remove_p.size() == removed) break;
+        if (!unit_prop(remove_u) || (!lazy_ && injective() && !p_graph_.unit_prop(remove_p, junk, junk))) {
+          valid_ = false;
+        }
+      }
+      return valid_;
+    }
+
 };
 
 #endif
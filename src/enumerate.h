@@ -0,0 +1,171 @@
+/*****************************************************************************
+  Author: Charlie Murphy
+  Email:  tcm3@cs.princeton.edu
+
+  Date:   October 18, 2026
+
+  Description: Enumeration and counting of embeddings. The search of
+    MatchEmbeds is continued after every solution: a candidate embedding is
+    completed by deciding its remaining open elements one at a time (with
+    local filtering only), reported once every element is fixed, and then
+    blocked by backtracking over the last decision.
+ *****************************************************************************/
+
+#include <vector>
+#include <stack>
+#include <utility>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include "definitions.h"
+#include "graph.h"
+#include "embedding.h"
+#include "selection.h"
+#include "match_embeds.h"
+#include "stats.h"
+
+#ifndef CM_ENUMERATE_H
+#define CM_ENUMERATE_H
+
+/* Receives an embedding as (element of a, element of b) pairs in the order of
+   a's elements. Returning false stops the enumeration. */
+template <class Element>
+using EmbeddingCallback = std::function<bool(const std::vector<std::pair<Element, Element>>&)>;
+
+/* Enumerate every embedding below the current state of e, calling emit with the
+   matching of each (every element of a matched and fixed). Returns false iff
+   emit asked to stop. */
+template <class Element, class Predicate, class Signature>
+bool enumerate_subtree(Embedding<Element, Predicate, Signature>& e, Var_selection sel, const std::function<bool(const std::vector<int>&)>& emit) {
+  Graph& u_graph = e.get_universe_graph();
+
+  std::vector<size_t> conflict_history, conflicts;
+  conflict_history.resize(u_graph.uSize(), 0);
+
+  std::vector<int> match1, match2, vis;
+  match1.resize(u_graph.uSize(), -1);
+  match2.resize(u_graph.vSize(), -1);
+  vis.resize(u_graph.uSize(), 0);
+
+  std::stack<decision> decisions;
+
+  while (true) {
+    if (!assign_candidates(e, match1, match2, vis)) {
+      if (decisions.empty()) return true;
+      backtrack(e, decisions);
+      continue;
+    }
+
+    size_t d_edge;
+    find_conflicts(e, match1, conflicts);
+    if (conflicts.size() == 0) {
+      /* match1 is an embedding: fix the first element that still has a choice */
+      for (d_edge = 0; d_edge < u_graph.uSize() && u_graph.uAdj(d_edge).size() == 1; ++d_edge);
+      if (d_edge == u_graph.uSize()) {
+        if (!emit(match1)) return false;
+        if (decisions.empty()) return true;
+        backtrack(e, decisions); /* blocks the solution just reported */
+        continue;
+      }
+      /* the decision is consistent with a known embedding, so local filtering suffices */
+      decisions.emplace(d_edge, match1[d_edge]);
+      e.decide(decisions.top(), false);
+    } else {
+      if (!select_variable(e, conflicts, sel, conflict_history, d_edge)) {
+        if (decisions.empty()) return true;
+        backtrack(e, decisions);
+        continue;
+      }
+      decisions.emplace(d_edge, match1[d_edge]);
+      e.decide(decisions.top());
+    }
+
+    if (!e.is_valid()) {
+      backtrack(e, decisions);
+    }
+  }
+}
+
+/* Enumerate the embeddings of e, calling callback (if set) with each one, until
+   max_solutions have been found (0 for all) or the callback returns false.
+   Returns the number of embeddings found (none if e is over its memory
+   budget, see Embedding::over_budget).
+
+   With parallel set, the subtrees below each value of the most constrained
+   element are searched concurrently on copies of e; callback invocations are
+   serialized but may arrive in any order. */
+template <class Element, class Predicate, class Signature>
+size_t EnumerateEmbeds(Embedding<Element, Predicate, Signature>& e, const EmbeddingCallback<Element>& callback,
+                       size_t max_solutions = 0, bool parallel = false, Var_selection sel = MIN_REMAINING_VALUES) {
+  if (e.over_budget() || !propagate_root(e)) return 0;
+  CM_TIME_PHASE(PHASE_SEARCH);
+
+  const Structure<Element, Predicate, Signature>& a = e.get_pattern();
+  const Structure<Element, Predicate, Signature>& b = e.get_target().structure();
+  std::mutex lock;
+  std::atomic<size_t> count(0);
+  std::atomic<bool> stop(false);
+
+  std::function<bool(const std::vector<int>&)> emit = [&](const std::vector<int>& match) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (stop) return false;
+    if (callback) {
+      std::vector<std::pair<Element, Element>> solution;
+      /* in the order of the elements of the pattern given, even when e reordered them */
+      for (size_t u = 0; u < match.size(); ++u) {
+        size_t i = e.local_u(u);
+        solution.push_back(std::make_pair(a.element(i), b.element(match[i])));
+      }
+      if (!callback(solution)) stop = true;
+    }
+    if (++count == max_solutions) stop = true;
+    return !stop;
+  };
+
+  Graph& u_graph = e.get_universe_graph();
+  size_t split = u_graph.uSize();
+  if (parallel) {
+    /* split on the element with the fewest (but more than one) values */
+    for (size_t u = 0; u < u_graph.uSize(); ++u) {
+      size_t n = u_graph.uAdj(u).size();
+      if (n > 1 && (split == u_graph.uSize() || n < u_graph.uAdj(split).size())) split = u;
+    }
+  }
+  if (split == u_graph.uSize()) {
+    enumerate_subtree(e, sel, emit);
+    return count;
+  }
+
+  std::vector<size_t> values;
+  for (size_t i = 0; i < u_graph.uAdj(split).size(); ++i) {
+    values.push_back(u_graph.uAdj(split)[i].vertex);
+  }
+  /* work done on other threads is handed back to the caller's statistics */
+  SolverStats* caller = &solver_stats();
+  std::vector<SolverStats> work(values.size(), SolverStats());
+  std::vector<char> remote(values.size(), 0);
+  #pragma omp parallel for schedule(dynamic)
+  for (size_t i = 0; i < values.size(); ++i) {
+    if (stop) continue;
+    SolverStats& local = solver_stats();
+    remote[i] = &local != caller;
+    if (remote[i]) local.clear();
+    Embedding<Element, Predicate, Signature> sub(e);
+    decision d(split, values[i]);
+    sub.decide(d);
+    if (sub.is_valid()) enumerate_subtree(sub, sel, emit);
+    if (remote[i]) work[i] = local;
+  }
+  for (size_t i = 0; i < values.size(); ++i) {
+    if (remote[i]) caller->add(work[i]);
+  }
+  return count;
+}
+
+/* Number of embeddings of e, counting at most max_solutions of them (0 for all) */
+template <class Element, class Predicate, class Signature>
+size_t CountEmbeds(Embedding<Element, Predicate, Signature>& e, size_t max_solutions = 0, bool parallel = false) {
+  return EnumerateEmbeds(e, EmbeddingCallback<Element>(), max_solutions, parallel);
+}
+
+#endif
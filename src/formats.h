@@ -9,24 +9,66 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <deque>
+#include <map>
 #include <cctype>
+#include <cstring>
+#include "structure.h"
+#include "mapped_file.h"
+#include "binary_format.h"
+
+#ifndef CM_FORMATS_H
+#define CM_FORMATS_H
 
 template <class Signature>
 Structure<std::string, std::string, Signature> read_struct_file(std::ifstream& ins, bool& valid);
 
 template <class Signature>
-Structure<std::string, std::string, Signature> read_structure(const std::string& file_name, bool& valid) {
-  std::string ext = file_name.substr(file_name.find_last_of(".") + 1);
+class StructFileReader;
+
+template <class Signature>
+Structure<std::string, std::string, Signature> read_lad_file(const std::string& file_name, bool labelled, bool& valid);
+
+template <class Signature>
+Structure<std::string, std::string, Signature> read_gfu_file(const std::string& file_name, bool& valid);
+
+template <class Signature>
+Structure<std::string, std::string, Signature> read_arg_file(const std::string& file_name, bool labelled, bool& valid);
+
+/* Read the (first) structure in file_name, which is in the given format:
+   struct, bstruct, lad, labelled-lad, gfu, arg or vf (labelled arg). An
+   empty format is taken from the file's extension. */
+template <class Signature>
+Structure<std::string, std::string, Signature> read_structure(const std::string& file_name, const std::string& format, bool& valid) {
+  std::string ext = format;
+  if (ext.empty()) {
+    size_t dot = file_name.find_last_of("./");
+    ext = (dot == std::string::npos || file_name[dot] == '/') ? "" : file_name.substr(dot + 1);
+  }
 
   if (ext == "struct") {
-    std::ifstream ins(file_name);
-    return read_struct_file<Signature>(ins, valid);
+    StructFileReader<Signature> reader(file_name);
+    return reader.next(valid);
+  } else if (ext == "bstruct") {
+    BinaryStructReader<Signature> reader(file_name);
+    return reader.next(valid);
+  } else if (ext == "lad" || ext == "labelled-lad") {
+    return read_lad_file<Signature>(file_name, ext == "labelled-lad", valid);
+  } else if (ext == "gfu") {
+    return read_gfu_file<Signature>(file_name, valid);
+  } else if (ext == "arg" || ext == "vf") {
+    return read_arg_file<Signature>(file_name, ext == "vf", valid);
   } else {
     valid = false;
     return Structure<std::string, std::string, Signature>();
   }
 }
 
+template <class Signature>
+Structure<std::string, std::string, Signature> read_structure(const std::string& file_name, bool& valid) {
+  return read_structure<Signature>(file_name, "", valid);
+}
+
 template <class Signature>
 Structure<std::string, std::string, Signature> read_struct_file(std::ifstream& ins, bool& valid) {
   Structure<std::string, std::string, Signature> s; // structure to return;
@@ -114,3 +156,403 @@ Structure<std::string, std::string, Signature> read_struct_file(std::ifstream& i
   }
   return s;
 }
+
+/* Builds the structure of a graph from a subgraph isomorphism benchmark: the
+   elements are the vertices "0", ..., "n-1", edges are propositions of the
+   binary relation "e" in both directions (the benchmark graphs are
+   undirected), and a vertex labelled L satisfies the unary predicate
+   "label_L". */
+template <class Signature>
+class GraphStructBuilder {
+ public:
+  typedef Structure<std::string, std::string, Signature> Str;
+
+  explicit GraphStructBuilder(size_t n) : n_(n), edge_(Str::add_relation("e")) {
+    for (size_t i = 0; i < n; ++i) {
+      s_.add_element(std::to_string(i));
+    }
+  }
+
+  size_t size() const { return n_; }
+
+  /* Add the edge {u, v}; false if either end is not a vertex */
+  bool edge(size_t u, size_t v) {
+    if (u >= n_ || v >= n_) return false;
+    size_t uv[2] = {u, v};
+    size_t vu[2] = {v, u};
+    s_.add_proposition(edge_, uv, 2);
+    s_.add_proposition(edge_, vu, 2);
+    return true;
+  }
+
+  void label(size_t u, const std::string& l) {
+    size_t q;
+    typename std::map<std::string, size_t>::iterator it = labels_.find(l);
+    if (it == labels_.end()) {
+      q = Str::add_relation("label_" + l);
+      labels_.emplace(l, q);
+    } else {
+      q = it->second;
+    }
+    s_.add_proposition(q, &u, 1);
+  }
+
+  Str& structure() { return s_; }
+
+ private:
+  size_t n_;
+  size_t edge_;
+  std::map<std::string, size_t> labels_;
+  Str s_;
+};
+
+/* LAD format: the number of vertices n, then for each vertex its number of
+   neighbours followed by the neighbours (0 based). Labelled LAD puts the
+   vertex label before the number of neighbours. */
+template <class Signature>
+Structure<std::string, std::string, Signature> read_lad_file(const std::string& file_name, bool labelled, bool& valid) {
+  std::ifstream ins(file_name);
+  size_t n;
+  if (!(ins >> n)) {
+    valid = false;
+    return Structure<std::string, std::string, Signature>();
+  }
+  GraphStructBuilder<Signature> g(n);
+  for (size_t u = 0; valid && u < n; ++u) {
+    std::string l;
+    size_t d, v;
+    if (labelled && ins >> l) g.label(u, l);
+    valid = (bool) (ins >> d);
+    for (size_t i = 0; valid && i < d; ++i) {
+      valid = (ins >> v) && g.edge(u, v);
+    }
+  }
+  return g.structure();
+}
+
+/* GFU format: a "#name" line, the number of vertices n, n vertex labels, the
+   number of edges m and m lines "u v" (0 based) */
+template <class Signature>
+Structure<std::string, std::string, Signature> read_gfu_file(const std::string& file_name, bool& valid) {
+  std::ifstream ins(file_name);
+  std::string name;
+  size_t n;
+  if (!(ins >> name) || name.empty() || name[0] != '#' || !(ins >> n)) {
+    valid = false;
+    return Structure<std::string, std::string, Signature>();
+  }
+  GraphStructBuilder<Signature> g(n);
+  for (size_t u = 0; valid && u < n; ++u) {
+    std::string l;
+    valid = (bool) (ins >> l);
+    if (valid) g.label(u, l);
+  }
+  size_t m, u, v;
+  valid = valid && (ins >> m);
+  for (size_t i = 0; valid && i < m; ++i) {
+    valid = (ins >> u >> v) && g.edge(u, v);
+  }
+  return g.structure();
+}
+
+/* Binary ARG format of the VF2 graph database: little endian 16 bit words
+   holding the number of vertices n, then for each vertex its number of
+   outgoing edges followed by their targets. The labelled variant (vf) has n
+   vertex labels after n and an edge label after each target; edge labels
+   are ignored. */
+template <class Signature>
+Structure<std::string, std::string, Signature> read_arg_file(const std::string& file_name, bool labelled, bool& valid) {
+  MappedFile file(file_name);
+  const unsigned char* words = reinterpret_cast<const unsigned char*>(file.data());
+  size_t n_words = file.size() / 2, pos = 0;
+  auto word = [&](size_t& w) {
+    if (pos >= n_words) return false;
+    w = words[2 * pos] | (words[2 * pos + 1] << 8);
+    ++pos;
+    return true;
+  };
+
+  size_t n;
+  if (!file.is_open() || !word(n)) {
+    valid = false;
+    return Structure<std::string, std::string, Signature>();
+  }
+  GraphStructBuilder<Signature> g(n);
+  for (size_t u = 0; valid && labelled && u < n; ++u) {
+    size_t l;
+    valid = word(l);
+    if (valid) g.label(u, std::to_string(l));
+  }
+  for (size_t u = 0; valid && u < n; ++u) {
+    size_t d, v, l;
+    valid = word(d);
+    for (size_t i = 0; valid && i < d; ++i) {
+      valid = word(v) && (!labelled || word(l)) && g.edge(u, v);
+    }
+  }
+  return g.structure();
+}
+
+/* Interns byte strings to consecutive ids. Keys are not copied: they must stay
+   valid for the lifetime of the table unless inserted with owned = true. */
+class NameTable {
+ public:
+  static const size_t npos = (size_t) -1;
+
+  NameTable() : count_(0) {}
+
+  size_t size() const { return count_; }
+
+  /* id of s[0..n) if present, otherwise npos */
+  size_t find(const char* s, size_t n) const {
+    if (slots_.empty()) return npos;
+    size_t mask = slots_.size() - 1;
+    for (size_t i = hash(s, n) & mask; slots_[i].id != npos; i = (i + 1) & mask) {
+      if (slots_[i].len == n && memcmp(slots_[i].str, s, n) == 0) return slots_[i].id;
+    }
+    return npos;
+  }
+
+  /* Insert s[0..n) (assumes it is not present) and return its id */
+  size_t insert(const char* s, size_t n, bool owned) {
+    if (owned) {
+      owned_.push_back(std::string(s, n));
+      s = owned_.back().data();
+    }
+    if (2 * (count_ + 1) > slots_.size()) {
+      rehash(slots_.empty() ? 64 : 2 * slots_.size());
+    }
+    place(Slot(s, n, count_));
+    return count_++;
+  }
+
+  void clear() {
+    slots_.clear();
+    owned_.clear();
+    count_ = 0;
+  }
+
+ private:
+  struct Slot {
+    Slot(const char* s = NULL, size_t n = 0, size_t i = npos) : str(s), len(n), id(i) {}
+    const char* str;
+    size_t len;
+    size_t id;
+  };
+  std::vector<Slot> slots_;
+  std::deque<std::string> owned_; /* keys that do not point into the caller's buffer */
+  size_t count_;
+
+  static size_t hash(const char* s, size_t n) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < n; ++i) {
+      h = (h ^ (unsigned char) s[i]) * 0x100000001b3ULL;
+    }
+    return (size_t) (h ^ (h >> 29));
+  }
+
+  void place(const Slot& k) {
+    size_t mask = slots_.size() - 1;
+    size_t i = hash(k.str, k.len) & mask;
+    while (slots_[i].id != npos) i = (i + 1) & mask;
+    slots_[i] = k;
+  }
+
+  void rehash(size_t n) {
+    std::vector<Slot> old;
+    old.swap(slots_);
+    slots_.resize(n);
+    for (size_t i = 0; i < old.size(); ++i) {
+      if (old[i].id != npos) place(old[i]);
+    }
+  }
+};
+
+/* Reads the structures of a .struct file one after another from a memory
+   mapped copy of the file. Accepts the same grammar as read_struct_file:
+   predicate and element names may be quoted, whitespace outside of quotes is
+   ignored and # starts a comment that runs to the end of the line. Names are
+   interned directly from the mapping, so each distinct name is converted to
+   a string only once per structure. */
+template <class Signature>
+class StructFileReader {
+ public:
+  typedef Structure<std::string, std::string, Signature> Str;
+
+  explicit StructFileReader(const std::string& file_name) : file_(file_name), pos_(0), error_(0) {
+    for (int c = 0; c < 256; ++c) {
+      bool common = isspace(c) || c == '#' || c == '\'' || c == '\"';
+      pred_stop_[c] = common || c == '(' || c == ',' || c == '}';
+      var_stop_[c] = common || c == ',' || c == ')';
+    }
+  }
+
+  bool is_open() const { return file_.is_open(); }
+
+  /* Byte offset of the last parse error (the end of the file if it ended early) */
+  size_t error_offset() const { return error_; }
+
+  /* Parse the next structure in the file; valid is set to false on error */
+  Str next(bool& valid) {
+    Str s;
+    if (!file_.is_open()) {
+      valid = false;
+      error_ = 0;
+      return s;
+    }
+    const char* begin = file_.data();
+    const char* end = begin + file_.size();
+    const char* c = begin + pos_;
+
+    elements_.clear();
+    pred_.clear(); var_.clear();
+    vars_.clear();
+    size_t state(0);
+    char quote(0);
+
+    while (c < end && state < 4) {
+      if (*c == '#') {
+        const char* nl = static_cast<const char*>(memchr(c, '\n', end - c));
+        c = nl ? nl + 1 : end;
+        continue;
+      }
+      if (*c == '\'' || *c == '\"') {
+        if (quote == *c) {
+          quote = 0;
+          ++c;
+          continue;
+        } else if (!quote && ((state == 1 && pred_.empty()) || (state == 2 && var_.empty()))) {
+          quote = *c++;
+          continue;
+        } else if (!quote) {
+          state = 5;
+          break;
+        }
+      }
+      if (quote) {
+        (state == 1 ? pred_ : var_).append(c, 1);
+        ++c;
+        continue;
+      }
+      if (isspace((unsigned char) *c)) {
+        ++c;
+        continue;
+      }
+      switch (state) {
+        case 0:
+          if (*c == '{') { state = 1; ++c; }
+          else { state = 5; }
+          break;
+        case 1:
+          if (*c == '(') { state = 2; ++c; }
+          else if (*c == ',' || *c == '}') {
+            if (!pred_.empty()) {  // ignore empty string predicates
+              add(s);
+              pred_.clear();
+            }
+            state = (*c == ',') ? 1 : 4;
+            ++c;
+          } else {
+            c = scan(c, end, pred_stop_, pred_);
+          }
+          break;
+        case 2:
+          if (*c == ',' || *c == ')') {
+            if (!var_.empty()) { // ignore 0 length variables
+              vars_.push_back(element(s));
+              var_.clear();
+            }
+            if (*c == ')') {
+              add(s);
+              pred_.clear(); vars_.clear();
+              state = 3;
+            }
+            ++c;
+          } else {
+            c = scan(c, end, var_stop_, var_);
+          }
+          break;
+        case 3:
+          if (*c == ',') { state = 1; ++c; }
+          else if (*c == '}') { state = 4; ++c; }
+          else state = 5;
+          break;
+      }
+    }
+    pos_ = c - begin;
+    if (state != 4) {
+      valid = false;
+      error_ = pos_;
+    }
+    return s;
+  }
+
+ private:
+  /* A name being read: a span of the mapping, or a copy once it stops being contiguous */
+  class Token {
+   public:
+    Token() : begin_(NULL), len_(0), copied_(false) {}
+    bool empty() const { return len_ == 0; }
+    const char* data() const { return copied_ ? buf_.data() : begin_; }
+    size_t size() const { return len_; }
+    bool copied() const { return copied_; }
+    void clear() { len_ = 0; copied_ = false; }
+    void append(const char* p, size_t n) {
+      if (len_ == 0) {
+        begin_ = p;
+      } else if (copied_) {
+        buf_.append(p, n);
+      } else if (begin_ + len_ != p) {
+        buf_.assign(begin_, len_);
+        buf_.append(p, n);
+        copied_ = true;
+      }
+      len_ += n;
+    }
+   private:
+    const char* begin_;
+    size_t len_;
+    bool copied_;
+    std::string buf_;
+  };
+
+  MappedFile file_;
+  size_t pos_;
+  size_t error_;
+  bool pred_stop_[256];
+  bool var_stop_[256];
+  NameTable predicates_;        /* name -> index into pred_ids_ (shared by every structure in the file) */
+  std::vector<size_t> pred_ids_;
+  NameTable elements_;          /* name -> element id of the structure being read */
+  Token pred_, var_;
+  std::vector<size_t> vars_;
+
+  /* Consume the longest run of characters that cannot end a name */
+  static const char* scan(const char* c, const char* end, const bool* stop, Token& tok) {
+    const char* b = c;
+    while (c < end && !stop[(unsigned char) *c]) ++c;
+    if (c == b) ++c; /* a quote or other stop character not handled by the caller */
+    tok.append(b, c - b);
+    return c;
+  }
+
+  size_t element(Str& s) {
+    size_t id = elements_.find(var_.data(), var_.size());
+    if (id == NameTable::npos) {
+      id = elements_.insert(var_.data(), var_.size(), var_.copied());
+      s.add_element(std::string(var_.data(), var_.size()), id);
+    }
+    return id;
+  }
+
+  void add(Str& s) {
+    size_t id = predicates_.find(pred_.data(), pred_.size());
+    if (id == NameTable::npos) {
+      id = predicates_.insert(pred_.data(), pred_.size(), pred_.copied());
+      pred_ids_.push_back(Str::add_relation(std::string(pred_.data(), pred_.size())));
+    }
+    s.add_proposition(pred_ids_[id], vars_.data(), vars_.size());
+  }
+};
+
+#endif
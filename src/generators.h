@@ -0,0 +1,140 @@
+/*****************************************************************************
+  Author: Charlie Murphy
+  Email:  tcm3@cs.princeton.edu
+
+  Date:   October 18, 2026
+
+  Description: Random structure generators for benchmarking. Targets are
+    random structures (or graphs) and patterns are either independent random
+    structures or planted: a renamed substructure of the target, which is
+    guaranteed to embed, optionally perturbed with extra tuples to make
+    near misses that are (usually) unsatisfiable.
+ *****************************************************************************/
+
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+#include "structure.h"
+
+#ifndef CM_GENERATORS_H
+#define CM_GENERATORS_H
+
+/* A relation symbol and how many random tuples of it to draw */
+struct RelationSpec {
+  RelationSpec(const std::string& n, size_t a, size_t t) : name(n), arity(a), tuples(t) {}
+  std::string name;
+  size_t arity;
+  size_t tuples;
+};
+
+template <class Signature>
+class InstanceGenerator {
+ public:
+  typedef Structure<std::string, std::string, Signature> Str;
+
+  explicit InstanceGenerator(uint64_t seed) : rng_(seed) {}
+
+  /* n elements and, for each relation, its number of uniformly drawn tuples
+     (duplicates are dropped, so there may be fewer; none without elements) */
+  Str random_structure(size_t n, const std::vector<RelationSpec>& rels, const std::string& prefix = "x") {
+    Str s;
+    add_elements(s, n, prefix);
+    if (n == 0) return s;
+    std::uniform_int_distribution<size_t> elem(0, n - 1);
+    std::vector<size_t> vars;
+    for (size_t r = 0; r < rels.size(); ++r) {
+      size_t q = Str::add_relation(rels[r].name);
+      for (size_t t = 0; t < rels[r].tuples; ++t) {
+        vars.clear();
+        for (size_t k = 0; k < rels[r].arity; ++k) vars.push_back(elem(rng_));
+        s.add_proposition(q, vars.data(), vars.size());
+      }
+    }
+    return s;
+  }
+
+  /* An undirected G(n, p) graph over the binary relation e */
+  Str random_graph(size_t n, double p, const std::string& prefix = "x") {
+    Str s;
+    add_elements(s, n, prefix);
+    size_t q = Str::add_relation("e");
+    std::bernoulli_distribution edge(p);
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t j = i + 1; j < n; ++j) {
+        if (edge(rng_)) add_edge(s, q, i, j);
+      }
+    }
+    return s;
+  }
+
+  /* The substructure of b induced by k random elements, renamed in random order,
+     keeping each of its tuples with probability keep. Embeds into b. */
+  Str planted_pattern(const Str& b, size_t k, double keep) {
+    std::vector<size_t> order(b.universe_size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::shuffle(order.begin(), order.end(), rng_);
+    if (k > order.size()) k = order.size();
+
+    std::vector<size_t> rename(b.universe_size(), SIZE_MAX);
+    for (size_t i = 0; i < k; ++i) rename[order[i]] = i;
+
+    Str a;
+    add_elements(a, k, "a");
+    std::bernoulli_distribution kept(keep);
+    const PropTable& props = b.propositions();
+    std::vector<size_t> vars;
+    for (size_t i = 0; i < props.size(); ++i) {
+      vars.clear();
+      const size_t* bvars = props.vars(i);
+      for (size_t j = 0; j < props.arity(i) && rename[bvars[j]] != SIZE_MAX; ++j) {
+        vars.push_back(rename[bvars[j]]);
+      }
+      if (vars.size() == props.arity(i) && kept(rng_)) {
+        a.add_proposition(props.pred(i), vars.data(), vars.size());
+      }
+    }
+    return a;
+  }
+
+  /* Add extra random tuples of the relations in rels to a (the near miss of a
+     planted pattern). Graphs get the edges in both directions. Nothing is
+     added to an empty a or from an empty rels. */
+  void perturb(Str& a, const std::vector<RelationSpec>& rels, size_t extra, bool symmetric = false) {
+    if (a.universe_size() == 0 || rels.empty()) return;
+    std::uniform_int_distribution<size_t> elem(0, a.universe_size() - 1);
+    std::uniform_int_distribution<size_t> rel(0, rels.size() - 1);
+    std::vector<size_t> vars;
+    for (size_t t = 0; t < extra; ++t) {
+      const RelationSpec& r = rels[rel(rng_)];
+      size_t q = Str::add_relation(r.name);
+      vars.clear();
+      for (size_t k = 0; k < r.arity; ++k) vars.push_back(elem(rng_));
+      if (symmetric && vars.size() == 2) {
+        if (vars[0] == vars[1]) continue;
+        add_edge(a, q, vars[0], vars[1]);
+      } else {
+        a.add_proposition(q, vars.data(), vars.size());
+      }
+    }
+  }
+
+ private:
+  std::mt19937_64 rng_;
+
+  void add_elements(Str& s, size_t n, const std::string& prefix) {
+    for (size_t i = 0; i < n; ++i) {
+      s.add_element(prefix + std::to_string(i));
+    }
+  }
+
+  void add_edge(Str& s, size_t q, size_t u, size_t v) {
+    size_t uv[2] = {u, v};
+    size_t vu[2] = {v, u};
+    s.add_proposition(q, uv, 2);
+    s.add_proposition(q, vu, 2);
+  }
+};
+
+#endif
@@ -13,6 +13,7 @@
 #include <vector>
 #include <queue>
 #include <stack>
+#include "stats.h"
 
 #ifndef CM_GRAPH_H
 #define CM_GRAPH_H
@@ -42,24 +43,40 @@ class Graph{
     adj_v.resize(v_size);
   }
 
+  /* Grow the parts to at least u_size and v_size vertices */
+  void grow(size_t u_size, size_t v_size){
+    if (adj_u.size() < u_size) adj_u.resize(u_size);
+    if (adj_v.size() < v_size) adj_v.resize(v_size);
+  }
+
   /***********************************************
     Functions to access part's of the graph
    ***********************************************/
   size_t uSize() const { return adj_u.size(); }
   size_t vSize() const { return adj_v.size(); }
 
+  /* Heap bytes held by the adjacency lists */
+  size_t memory_bytes() const { return heap_bytes(adj_u) + heap_bytes(adj_v); }
+
   std::vector<Edge>& uAdj(size_t u){ return adj_u[u]; }
   const std::vector<Edge>& uAdj(size_t u) const { return adj_u[u]; }
   std::vector<Edge>& vAdj(size_t v){ return adj_v[v]; }
   const std::vector<Edge>& vAdj(size_t v) const { return adj_v[v]; }
 
-  /* Simple linear search for v in adj_u[u]
-     We could do logarithmic if we maintained
+  /* Simple linear search for v in adj_u[u] (or for u in adj_v[v], whichever
+     is shorter). We could do logarithmic if we maintained
      adj_u[u] was sorted (but adding edges
      would be linear time then) */
   bool has_edge(size_t u, size_t v) const {
     if (u >= adj_u.size() || v >= adj_v.size()) return false;
 
+    if (adj_v[v].size() < adj_u[u].size()) {
+      for (size_t i = 0; i < adj_v[v].size(); ++i){
+        if (adj_v[v][i].vertex == u)
+          return true;
+      }
+      return false;
+    }
     for (size_t i = 0; i < adj_u[u].size(); ++i){
       if (adj_u[u][i].vertex == v)
   	return true;
@@ -87,6 +104,7 @@ class Graph{
   */
   size_t max_matching(std::vector<int>& matches_u, std::vector<int>& matches_v, std::vector<int>& vis) const {
     size_t ans = 0;
+    CM_COUNT(matchings);
     for (size_t i = 0; i < adj_u.size(); ++i){
       ans += (matches_u[i] != -1) || dfs(matches_u, matches_v, vis, i, i + 1);
     }
@@ -107,6 +125,7 @@ class Graph{
       u = units.front();
       if (adj_u[u].size() == 1){
 	v = adj_u[u][0];
+	CM_COUNT(unit_props);
   	u_units.push_back(u); v_units.push_back(v.vertex);
 	size_t i = 0;
 	while (i < adj_v[v.vertex].size()){
@@ -136,6 +155,7 @@ class Graph{
    */
   void remove_edge(size_t u, size_t pos){
     Edge k = adj_u[u][pos], l;
+    CM_COUNT(edges_removed);
     if (pos != adj_u[u].size() - 1){
       adj_u[u][pos] = l = adj_u[u].back();
       adj_v[l.vertex][l.position].position = pos;
@@ -148,6 +168,17 @@ class Graph{
     adj_v[k.vertex].pop_back();
   }
 
+  /* Remove the edge (u, v) if the graph has it; returns whether it did */
+  bool remove_if_present(size_t u, size_t v){
+    for (size_t i = 0; i < adj_v[v].size(); ++i){
+      if (adj_v[v][i].vertex == u){
+        remove_edge(u, adj_v[v][i].position);
+        return true;
+      }
+    }
+    return false;
+  }
+
   /* Remove all edges inconsistent with U[i] |-> V[i],
      Assumption:
        U.size() == V.size()
@@ -210,6 +241,7 @@ class Graph{
 		if (adj_u[adj_v[v][j].vertex].size() == 0) {
 		    return false;
 		} else if (adj_u[adj_v[v][j].vertex].size() == 1) {
+		    CM_COUNT(unit_props);
 		    units.emplace(adj_v[v][j].vertex,
 				  adj_u[adj_v[v][j].vertex][0].vertex);
 		}
@@ -221,6 +253,20 @@ class Graph{
     return true;
   }
 
+  /* (u, v) is the only choice left for u, but without a matching v stays a
+     choice for others: remove the other edges incident to u only */
+  void keep_edge(size_t u, size_t v, std::vector<VertexPair>& removed){
+    size_t j = 0;
+    while (j < adj_u[u].size()){
+      if (adj_u[u][j].vertex != v){
+        removed.emplace_back(u, adj_u[u][j].vertex);
+        remove_edge(u, j);
+      } else {
+        ++j;
+      }
+    }
+  }
+
   /* Print the adjacency list of the graph [u -> v] */
   void print_graph() const {
     for (size_t i = 0; i < adj_u.size(); ++i){
@@ -295,6 +341,7 @@ class Graph{
   bool dfs(std::vector<int>& matches_u, std::vector<int>& matches_v, std::vector<int>& vis, int x, int iter) const {
     if (vis[x] == iter) return false;
     vis[x] = iter;
+    CM_COUNT(augment_steps);
     for (size_t i = 0; i < adj_u[x].size(); ++i){
       int y = adj_u[x][i].vertex;
       if (matches_v[y] < 0 || dfs(matches_u, matches_v, vis, matches_v[y], iter)){
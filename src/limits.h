@@ -0,0 +1,105 @@
+/*****************************************************************************
+  Author: Charlie Murphy
+  Email:  tcm3@cs.princeton.edu
+
+  Date:   October 18, 2026
+
+  Description: Limits on a search for an embedding
+ *****************************************************************************/
+
+#include <cstddef>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include "stats.h"
+
+#ifndef CM_LIMITS_H
+#define CM_LIMITS_H
+
+/* Outcome of a limited search */
+enum Search_result {
+  UNSAT = 0,  // no embedding exists
+  SAT,        // an embedding exists
+  UNKNOWN,    // a limit was reached first
+};
+
+/* Limits checked at every decision and backtrack; a deadline and the
+   cancel flag are also checked as filtering goes (see interrupts). Zero
+   means unlimited. The clock is only read every CLOCK_PERIOD checks to
+   keep the checks cheap, except by check_now. */
+struct SearchLimits {
+  typedef std::chrono::steady_clock Clock;
+  static const size_t CLOCK_PERIOD = 16;
+
+  SearchLimits() : has_deadline(false), budget(Clock::duration::zero()), max_decisions(0), max_backtracks(0), cancel(NULL),
+    countdown_(0) {}
+
+  /* Limits with a deadline of budget from now */
+  template <class Duration>
+  static SearchLimits within(Duration budget) {
+    SearchLimits l;
+    l.deadline = Clock::now() + budget;
+    l.has_deadline = true;
+    return l;
+  }
+
+  /* Limits with a deadline of budget from the start of each search they are
+     given to, e.g. for searches queued on a thread pool */
+  template <class Duration>
+  static SearchLimits per_search(Duration budget) {
+    SearchLimits l;
+    l.budget = std::chrono::duration_cast<Clock::duration>(budget);
+    return l;
+  }
+
+  /* The limits of a search starting now: the budget becomes a deadline
+     (the earlier one if there is a deadline already) */
+  SearchLimits started() const {
+    SearchLimits l(*this);
+    if (budget != Clock::duration::zero()) {
+      Clock::time_point end = Clock::now() + budget;
+      l.deadline = has_deadline ? std::min(deadline, end) : end;
+      l.has_deadline = true;
+      l.budget = Clock::duration::zero();
+    }
+    return l;
+  }
+
+  Clock::time_point deadline;
+  bool has_deadline;
+  Clock::duration budget;   /* per search, zero for none (see per_search) */
+  size_t max_decisions;
+  size_t max_backtracks;
+  const std::atomic<bool>* cancel;  /* set to true from any thread to stop the search */
+
+  /* Returns the reason to stop (NOT_STOPPED to keep going) */
+  Stop_reason check(const SearchStats& stats) {
+    if (max_decisions != 0 && stats.decisions > max_decisions) return DECISION_LIMIT;
+    if (max_backtracks != 0 && stats.backtracks > max_backtracks) return BACKTRACK_LIMIT;
+    if (cancel != NULL && cancel->load(std::memory_order_relaxed)) return CANCELLED;
+    if (has_deadline) {
+      if (countdown_ == 0) {
+        countdown_ = CLOCK_PERIOD;
+        if (Clock::now() >= deadline) return DEADLINE;
+      }
+      --countdown_;
+    }
+    return NOT_STOPPED;
+  }
+
+  /* Can the limits stop filtering, which makes no decisions or backtracks? */
+  bool interrupts() const {
+    return has_deadline || budget != Clock::duration::zero() || cancel != NULL;
+  }
+
+  /* check, reading the clock this time: for checks far apart */
+  Stop_reason check_now(const SearchStats& stats) {
+    countdown_ = 0;
+    return check(stats);
+  }
+
+ private:
+  size_t countdown_;
+};
+
+#endif
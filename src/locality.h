@@ -0,0 +1,103 @@
+/*****************************************************************************
+  Author: Charlie Murphy
+  Email:  tcm3@cs.princeton.edu
+
+  Date:   October 18, 2026
+
+  Description: Renumbering a structure for locality. Element ids follow the
+    order in which the parser first saw each element, so elements occurring
+    together can be far apart in every array indexed by element. Reverse
+    Cuthill-McKee over the elements, where two elements are adjacent when
+    they occur in a common proposition, gives neighbours nearby ids; the
+    propositions are then sorted by their renumbered arguments.
+ *****************************************************************************/
+
+#include <vector>
+#include <algorithm>
+#include "structure.h"
+#include "definitions.h"
+
+#ifndef CM_LOCALITY_H
+#define CM_LOCALITY_H
+
+/* A reverse Cuthill-McKee order of the n elements of a structure with
+   propositions props (order[i] is the element to number i): breadth first
+   from an element of least degree in each component, visiting the
+   neighbours of each element by increasing degree */
+inline std::vector<size_t> locality_order(const PropTable& props, size_t n) {
+  std::vector<std::vector<size_t>> occ(n);
+  for (size_t p = 0; p < props.size(); ++p) {
+    const size_t* vars = props.vars(p);
+    for (size_t k = 0; k < props.arity(p); ++k) occ[vars[k]].push_back(p);
+  }
+  std::vector<size_t> starts(n);
+  for (size_t v = 0; v < n; ++v) starts[v] = v;
+  std::stable_sort(starts.begin(), starts.end(), [&occ](size_t x, size_t y) { return occ[x].size() < occ[y].size(); });
+
+  std::vector<size_t> order;
+  order.reserve(n);
+  std::vector<char> seen(n, 0);
+  std::vector<size_t> next;
+  for (size_t s = 0; s < n; ++s) {
+    if (seen[starts[s]]) continue;
+    seen[starts[s]] = 1;
+    /* order doubles as the queue of the search */
+    for (size_t head = order.size(), v = starts[s]; ; v = order[head]) {
+      if (head == order.size()) order.push_back(v);
+      ++head;
+      next.clear();
+      for (size_t i = 0; i < occ[v].size(); ++i) {
+        const size_t* vars = props.vars(occ[v][i]);
+        for (size_t k = 0; k < props.arity(occ[v][i]); ++k) {
+          if (!seen[vars[k]]) {
+            seen[vars[k]] = 1;
+            next.push_back(vars[k]);
+          }
+        }
+      }
+      std::stable_sort(next.begin(), next.end(), [&occ](size_t x, size_t y) { return occ[x].size() < occ[y].size(); });
+      order.insert(order.end(), next.begin(), next.end());
+      if (head == order.size()) break;
+    }
+  }
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+/* A copy of s with element order[i] of s as its element i and the
+   propositions sorted by their renumbered arguments; prop_order[j] is set
+   to the proposition of s that became proposition j */
+template <class Element, class Predicate, class Signature>
+Structure<Element, Predicate, Signature> renumbered(const Structure<Element, Predicate, Signature>& s, const std::vector<size_t>& order,
+                                                    std::vector<size_t>& prop_order) {
+  Structure<Element, Predicate, Signature> r;
+  std::vector<size_t> id(order.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    r.add_element(s.element(order[i]));
+    id[order[i]] = i;
+  }
+  const PropTable& props = s.propositions();
+  PropTable local;
+  local.reserve(props.size(), props.num_args());
+  std::vector<size_t> vars;
+  for (size_t p = 0; p < props.size(); ++p) {
+    vars.resize(props.arity(p));
+    for (size_t k = 0; k < vars.size(); ++k) vars[k] = id[props.vars(p)[k]];
+    local.push_back(props.pred(p), vars.data(), vars.size());
+  }
+  prop_order.resize(props.size());
+  for (size_t p = 0; p < prop_order.size(); ++p) prop_order[p] = p;
+  std::sort(prop_order.begin(), prop_order.end(), [&local](size_t x, size_t y) {
+    if (!std::equal(local.vars(x), local.vars(x) + std::min(local.arity(x), local.arity(y)), local.vars(y))) {
+      return std::lexicographical_compare(local.vars(x), local.vars(x) + local.arity(x), local.vars(y), local.vars(y) + local.arity(y));
+    }
+    return local.arity(x) != local.arity(y) ? local.arity(x) < local.arity(y) : local.pred(x) < local.pred(y);
+  });
+  for (size_t j = 0; j < prop_order.size(); ++j) {
+    size_t p = prop_order[j];
+    r.add_proposition(local.pred(p), local.vars(p), local.arity(p));
+  }
+  return r;
+}
+
+#endif
@@ -0,0 +1,79 @@
+/*******************************************************************
+    Author: Charlie Murphy
+    Email:  tcm3@cs.princeton.edu
+
+    Date:   October 18, 2026
+
+    Description: Read only memory mapping of a file (POSIX)
+ *******************************************************************/
+#include <string>
+#include <cstddef>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifndef CM_MAPPED_FILE_H
+#define CM_MAPPED_FILE_H
+
+/* Maps an entire file read only into memory for the lifetime of the
+   object. Empty files are open with size() == 0 and a null data(). */
+class MappedFile {
+ public:
+  MappedFile() : data_(NULL), size_(0), open_(false) {}
+
+  explicit MappedFile(const std::string& file_name) : data_(NULL), size_(0), open_(false) {
+    open(file_name);
+  }
+
+  ~MappedFile() { close(); }
+
+  bool open(const std::string& file_name) {
+    close();
+    int fd = ::open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      ::close(fd);
+      return false;
+    }
+    size_ = (size_t) st.st_size;
+    if (size_ != 0) {
+      void* m = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (m == MAP_FAILED) {
+        ::close(fd);
+        size_ = 0;
+        return false;
+      }
+      madvise(m, size_, MADV_SEQUENTIAL);
+      data_ = static_cast<const char*>(m);
+    }
+    ::close(fd); /* the mapping stays valid after closing the descriptor */
+    open_ = true;
+    return true;
+  }
+
+  void close() {
+    if (data_ != NULL) {
+      munmap(const_cast<char*>(data_), size_);
+    }
+    data_ = NULL;
+    size_ = 0;
+    open_ = false;
+  }
+
+  bool is_open() const { return open_; }
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const char* data_;
+  size_t size_;
+  bool open_;
+
+  /* a mapping is owned by exactly one object */
+  MappedFile(const MappedFile&);
+  MappedFile& operator = (const MappedFile&);
+};
+
+#endif
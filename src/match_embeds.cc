@@ -11,32 +11,516 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <sstream>
+#include <chrono>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "structure.h"
 #include "embedding.h"
 #include "signature.h"
 #include "match_embeds.h"
+#include "enumerate.h"
 #include "formats.h"
+#include "thread_pool.h"
+#include "service.h"
+#include "trace.h"
+#include "database.h"
+#include "cache.h"
+#include "batch.h"
 
 using namespace std;
 
-int main(int argc, char ** argv) {
+typedef Structure<string, string, MultiSetSignature> Str;
+typedef ResultCache<string, string, MultiSetSignature> Cache;
+
+/* Read the pair of structures in file_name with the given reader type */
+template <class Reader>
+bool read_pair(const char* file_name, Str& s1, Str& s2) {
+  CM_TIME_PHASE(PHASE_READ);
+  Reader reader(file_name);
+  if (!reader.is_open()) {
+    cerr << "Could not open " << file_name << endl;
+    return false;
+  }
+  bool valid = true;
+  s1 = reader.next(valid);
+  if (!valid) {
+    cerr << "Structure 1 in " << file_name << " is not a valid structure (byte " << reader.error_offset() << ")!" << endl;
+    return false;
+  }
+  s2 = reader.next(valid);
+  if (!valid) {
+    cerr << "Structure 2 in " << file_name << " is not a valid structure (byte " << reader.error_offset() << ")!" << endl;
+    return false;
+  }
+  return true;
+}
+
+/* .bstruct files are binary, anything else is assumed to be in struct format */
+bool read_pair(const string& file_name, Str& s1, Str& s2) {
+  if (file_name.size() > 8 && file_name.substr(file_name.size() - 8) == ".bstruct") {
+    return read_pair<BinaryStructReader<MultiSetSignature>>(file_name.c_str(), s1, s2);
+  }
+  return read_pair<StructFileReader<MultiSetSignature>>(file_name.c_str(), s1, s2);
+}
+
+/* What to report for each instance */
+struct Options {
+  Options() : count(false), enumerate(false), max_solutions(0), timeout_ms(0), max_decisions(0), max_backtracks(0), stats(NULL),
+              trace_format(TraceSink::BINARY), trace_edges(false), cache(NULL) {}
+  bool count;            /* the number of embeddings */
+  bool enumerate;        /* each embedding followed by their number */
+  size_t max_solutions;  /* stop counting / enumerating after this many (0 = all) */
+  size_t timeout_ms;     /* search limits: answer "Unknown" once reached (0 = unlimited) */
+  size_t max_decisions;
+  size_t max_backtracks;
+  ostream* stats;        /* one line of JSON statistics per instance */
+  string trace;          /* file to write the search tree to */
+  TraceSink::Format trace_format;
+  bool trace_edges;      /* include the edges removed by each decision */
+  EmbeddingOptions embedding;
+  Cache* cache;          /* results of earlier instances, up to renaming */
+};
+
+/* Solve the instance in file_name: "True", "False" or "" if it could not be read
+   (or the embeddings / their number as selected by opts). The work done is
+   left in solver_stats(), the memory held in memory, and a search stopped by
+   a limit sets stop. */
+string solve_file(const string& file_name, const Options& opts, Stop_reason& stop, MemoryUsage& memory) {
+  stop = NOT_STOPPED;
+  memory = MemoryUsage();
+  /* the deadline covers building the Embedding, which it cannot
+     interrupt, as well as the search */
+  SearchLimits limits;
+  if (opts.timeout_ms != 0) limits = SearchLimits::within(chrono::milliseconds(opts.timeout_ms));
+  limits.max_decisions = opts.max_decisions;
+  limits.max_backtracks = opts.max_backtracks;
+  Str s1, s2;
+  if (!read_pair(file_name, s1, s2)) return "";
+  /* a hit skips building the Embedding as well as the search */
+  CanonicalForm f1, f2;
+  bool cached = opts.cache != NULL && !opts.enumerate && !opts.count;
+  if (cached) {
+    f1 = canonical_form(s1);
+    f2 = canonical_form(s2);
+    Search_result r;
+    if (opts.cache->lookup(f1, f2, r)) return r == SAT ? "True" : "False";
+  }
+  Embedding<string, string, MultiSetSignature> emb(s1, s2, opts.embedding);
+  memory = emb.memory_usage();
+  if (emb.over_budget()) stop = MEMORY_LIMIT;
+  if (opts.enumerate) {
+    ostringstream outs;
+    size_t n = EnumerateEmbeds(emb, EmbeddingCallback<string>([&outs](const vector<pair<string, string>>& m) {
+      outs << "{";
+      for (size_t i = 0; i < m.size(); ++i) {
+        outs << (i == 0 ? "" : ", ") << m[i].first << " -> " << m[i].second;
+      }
+      outs << "}" << endl;
+      return true;
+    }), opts.max_solutions, true);
+    outs << n;
+    return outs.str();
+  } else if (opts.count) {
+    return to_string(CountEmbeds(emb, opts.max_solutions, true));
+  }
+  SearchStats stats;
+  unique_ptr<TraceSink> trace;
+  if (!opts.trace.empty()) {
+    trace.reset(new TraceSink(opts.trace, opts.trace_format, opts.trace_edges));
+    if (!trace->is_open()) cerr << "Could not write " << opts.trace << endl;
+  }
+  Search_result r = MatchEmbeds(emb, limits, stats, MIN_REMAINING_VALUES, trace.get());
+  stop = stats.stop_reason;
+  memory = emb.memory_usage();
+  memory.decisions = stats.peak_logged * sizeof(Graph::VertexPair);
+  if (cached) opts.cache->store(f1, f2, r, emb.solution());
+  return r == SAT ? "True" : (r == UNSAT ? "False" : "Unknown");
+}
+
+/* s as a JSON string literal */
+string json_string(const string& s) {
+  ostringstream outs;
+  outs << '"';
+  for (size_t i = 0; i < s.size(); ++i) {
+    unsigned char c = s[i];
+    if (c == '"' || c == '\\') {
+      outs << '\\' << c;
+    } else if (c < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      outs << buf;
+    } else {
+      outs << c;
+    }
+  }
+  outs << '"';
+  return outs.str();
+}
 
-  for (size_t i = 1; i < argc; ++i) {
-    Structure<string, string, MultiSetSignature> s1, s2;
+/* Rough peak memory of solving the instance in file_name, from its size
+   alone: the predicate graph grows with the product of the numbers of
+   tuples, so this can be far off (see --instance-mb) */
+size_t instance_bytes(const string& file_name) {
+  struct stat st;
+  if (stat(file_name.c_str(), &st) != 0) return 0;
+  bool binary = file_name.size() > 8 && file_name.substr(file_name.size() - 8) == ".bstruct";
+  return (size_t) st.st_size * (binary ? 2 : 8);
+}
 
-    ifstream ins(argv[i]); // assumes pair of structs in struct format
-    bool valid = true;
-    s1 = read_struct_file<MultiSetSignature>(ins, valid);
+/* Answer service requests read from in (one per line) on out */
+void serve(SolverService<MultiSetSignature>& service, istream& in, ostream& out) {
+  string line;
+  while (getline(in, line) && line != "quit") {
+    if (line.empty()) continue;
+    out << service.handle(line) << endl;
+  }
+}
+
+/* Answer service requests from the connection fd (one per line) */
+void serve_connection(SolverService<MultiSetSignature>& service, int fd) {
+  string buf;
+  char chunk[4096];
+  ssize_t n;
+  while ((n = read(fd, chunk, sizeof(chunk))) > 0) {
+    buf.append(chunk, n);
+    size_t nl;
+    while ((nl = buf.find('\n')) != string::npos) {
+      string line = buf.substr(0, nl);
+      buf.erase(0, nl + 1);
+      if (line == "quit") {
+        close(fd);
+        return;
+      }
+      if (line.empty()) continue;
+      string response = service.handle(line) + "\n";
+      for (size_t off = 0; off < response.size(); ) {
+        ssize_t w = write(fd, response.data() + off, response.size() - off);
+        if (w <= 0) {
+          close(fd);
+          return;
+        }
+        off += w;
+      }
+    }
+  }
+  close(fd);
+}
+
+/* Accept connections on the Unix socket at path, serving each on the pool */
+int serve_socket(SolverService<MultiSetSignature>& service, const string& path, size_t jobs) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (fd < 0 || path.size() >= sizeof(addr.sun_path)) {
+    cerr << "Could not create socket " << path << endl;
+    return 1;
+  }
+  strcpy(addr.sun_path, path.c_str());
+  unlink(path.c_str());
+  if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+    cerr << "Could not listen on " << path << endl;
+    close(fd);
+    return 1;
+  }
+  ThreadPool pool(jobs);
+  int conn;
+  while ((conn = accept(fd, NULL, NULL)) >= 0) {
+    pool.submit([&service, conn]() { serve_connection(service, conn); });
+  }
+  close(fd);
+  return 0;
+}
+
+/* Print the targets (the first structure of each file) that the pattern embeds into */
+int screen_targets(const string& pattern, const vector<string>& files, size_t jobs, const EmbeddingOptions& options) {
+  bool valid = true;
+  Str a = read_structure<MultiSetSignature>(pattern, valid);
+  if (!valid) {
+    cerr << "Could not read a structure from " << pattern << endl;
+    return 1;
+  }
+  TargetDatabase<string, string, MultiSetSignature> db;
+  vector<string> names;
+  for (size_t i = 0; i < files.size(); ++i) {
+    valid = true;
+    shared_ptr<Str> b = make_shared<Str>(read_structure<MultiSetSignature>(files[i], valid));
     if (!valid) {
-      cerr << "Structure 1 in " << argv[i] << " is not a valid structure!" << endl;
+      cerr << "Could not read a structure from " << files[i] << endl;
       continue;
     }
-    s2 = read_struct_file<MultiSetSignature>(ins, valid);
+    db.add(b);
+    names.push_back(files[i]);
+  }
+  ScreenStats stats;
+  vector<size_t> matches = db.query(a, jobs, &stats, options);
+  for (size_t i = 0; i < matches.size(); ++i) {
+    cout << names[matches[i]] << endl;
+  }
+  cerr << stats.targets << " targets, " << stats.candidates << " verified, " << stats.matches << " matches" << endl;
+  return 0;
+}
+
+/* Print whether each pattern (the first structure of each file) embeds into
+   the target, in order, sharing the candidates across the patterns */
+int match_batch(const string& target, const vector<string>& files, size_t jobs, const Options& opts) {
+  bool valid = true;
+  shared_ptr<Str> b = make_shared<Str>(read_structure<MultiSetSignature>(target, valid));
+  if (!valid) {
+    cerr << "Could not read a structure from " << target << endl;
+    return 1;
+  }
+  vector<unique_ptr<Str>> owned;
+  vector<const Str*> patterns;
+  for (size_t i = 0; i < files.size(); ++i) {
+    valid = true;
+    owned.emplace_back(new Str(read_structure<MultiSetSignature>(files[i], valid)));
     if (!valid) {
-      cerr << "Structure 2 in " << argv[i] << " is not a valid structure!" << endl;
-      continue;
+      cerr << "Could not read a structure from " << files[i] << endl;
+      return 1;
+    }
+    patterns.push_back(owned.back().get());
+  }
+  SearchLimits limits;
+  if (opts.timeout_ms != 0) limits = SearchLimits::per_search(chrono::milliseconds(opts.timeout_ms));
+  limits.max_decisions = opts.max_decisions;
+  limits.max_backtracks = opts.max_backtracks;
+  BatchStats stats;
+  vector<SearchStats> search_stats;
+  vector<Search_result> results = MatchEmbedsBatch(patterns, make_shared<const Target<string, string, MultiSetSignature>>(b, opts.embedding.reorder),
+                                                   jobs, opts.embedding, limits, &stats, &search_stats);
+  size_t decisions = 0, backtracks = 0;
+  for (size_t i = 0; i < results.size(); ++i) {
+    cout << (results[i] == SAT ? "True" : (results[i] == UNSAT ? "False" : "Unknown")) << endl;
+    if (results[i] == UNKNOWN) cerr << files[i] << ": stopped by " << stop_reason_name(search_stats[i].stop_reason) << endl;
+    decisions += search_stats[i].decisions;
+    backtracks += search_stats[i].backtracks;
+  }
+  cerr << stats.patterns << " patterns, " << stats.signatures << " of " << stats.elements << " signatures and "
+       << stats.tuples << " of " << stats.propositions << " propositions distinct, "
+       << decisions << " decisions and " << backtracks << " backtracks" << endl;
+  return 0;
+}
+
+void usage() {
+  cerr << "usage: match-embeds [-j threads] [--stream] [--mem-limit MB] [--instance-mb MB]" << endl;
+  cerr << "                    [--timeout ms] [--max-decisions n] [--max-backtracks n]" << endl;
+  cerr << "                    [--count | --enumerate] [--max-solutions k] [--stats-json file]" << endl;
+  cerr << "                    [--trace file [--trace-chrome] [--trace-edges]] [--no-precheck] [--no-symmetry]" << endl;
+  cerr << "                    [--no-decompose] [--reorder] [--lazy] [--parallel-filter] [--hom] [--cache file [--cache-mb n]]" << endl;
+  cerr << "                    file1.struct ... fileN.struct" << endl;
+  cerr << "       match-embeds --convert in.struct out.bstruct" << endl;
+  cerr << "       match-embeds [-j threads] (--serve | --socket path)" << endl;
+  cerr << "       match-embeds [-j threads] --screen pattern.struct target1.struct ... targetN.struct" << endl;
+  cerr << "       match-embeds [-j threads] --batch target.struct pattern1.struct ... patternN.struct" << endl;
+  cerr << "--mem-limit counts each instance as its --instance-mb, or without one as an estimate from its file size" << endl;
+}
+
+int main(int argc, char ** argv) {
+
+  /* match-embeds --convert in.struct out.bstruct */
+  if (argc == 4 && string(argv[1]) == "--convert") {
+    Str s1, s2;
+    if (!read_pair(argv[2], s1, s2)) return 1;
+    vector<const Str*> structs;
+    structs.push_back(&s1);
+    structs.push_back(&s2);
+    if (!write_binary_structures<MultiSetSignature>(argv[3], structs, true)) {
+      cerr << "Could not write " << argv[3] << endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  size_t jobs = 1;        /* instances solved concurrently */
+  bool stream = false;    /* print results as they finish, tagged with the file name */
+  size_t mem_limit = 0;   /* bytes of estimated instance memory in flight (0 = unlimited) */
+  Options opts;
+  bool serve_stdin = false;
+  string socket_path;
+  string screen;          /* pattern to look for in every file */
+  string batch;           /* target to look for every file in */
+  string stats_file;      /* where to write per instance statistics ("-" for stderr) */
+  string cache_file;      /* results kept across runs */
+  size_t cache_mb = 256;
+  vector<string> files;
+  for (int i = 1; i < argc; ++i) {
+    string arg(argv[i]);
+    if ((arg == "-j" || arg == "--jobs") && i + 1 < argc) {
+      jobs = strtoul(argv[++i], NULL, 10);
+      if (jobs == 0) jobs = thread::hardware_concurrency();
+    } else if (arg == "--serve") {
+      serve_stdin = true;
+    } else if (arg == "--socket" && i + 1 < argc) {
+      socket_path = argv[++i];
+    } else if (arg == "--count") {
+      opts.count = true;
+    } else if (arg == "--enumerate") {
+      opts.enumerate = true;
+    } else if (arg == "--max-solutions" && i + 1 < argc) {
+      opts.max_solutions = strtoul(argv[++i], NULL, 10);
+    } else if (arg == "--timeout" && i + 1 < argc) {
+      opts.timeout_ms = strtoul(argv[++i], NULL, 10);
+    } else if (arg == "--max-decisions" && i + 1 < argc) {
+      opts.max_decisions = strtoul(argv[++i], NULL, 10);
+    } else if (arg == "--max-backtracks" && i + 1 < argc) {
+      opts.max_backtracks = strtoul(argv[++i], NULL, 10);
+    } else if (arg == "--stats-json" && i + 1 < argc) {
+      stats_file = argv[++i];
+    } else if (arg == "--trace" && i + 1 < argc) {
+      opts.trace = argv[++i];
+    } else if (arg == "--trace-chrome") {
+      opts.trace_format = TraceSink::CHROME;
+    } else if (arg == "--trace-edges") {
+      opts.trace_edges = true;
+    } else if (arg == "--no-precheck") {
+      opts.embedding.precheck = false;
+    } else if (arg == "--no-symmetry") {
+      opts.embedding.target_symmetry = opts.embedding.pattern_symmetry = false;
+    } else if (arg == "--lazy") {
+      opts.embedding.lazy_predicates = true;
+    } else if (arg == "--parallel-filter") {
+      opts.embedding.parallel_filter = true;
+    } else if (arg == "--no-decompose") {
+      opts.embedding.decompose = false;
+    } else if (arg == "--reorder") {
+      opts.embedding.reorder = true;
+    } else if (arg == "--hom") {
+      opts.embedding.homomorphism = true;
+    } else if (arg == "--cache" && i + 1 < argc) {
+      cache_file = argv[++i];
+    } else if (arg == "--cache-mb" && i + 1 < argc) {
+      cache_mb = strtoul(argv[++i], NULL, 10);
+    } else if (arg == "--screen" && i + 1 < argc) {
+      screen = argv[++i];
+    } else if (arg == "--batch" && i + 1 < argc) {
+      batch = argv[++i];
+    } else if (arg == "--stream") {
+      stream = true;
+    } else if (arg == "--mem-limit" && i + 1 < argc) {
+      mem_limit = strtoul(argv[++i], NULL, 10) << 20;
+    } else if (arg == "--instance-mb" && i + 1 < argc) {
+      opts.embedding.memory_budget = strtoul(argv[++i], NULL, 10) << 20;
+    } else if (arg.size() > 1 && arg[0] == '-') {
+      usage();
+      return 1;
+    } else {
+      files.push_back(arg);
     }
-    Embedding<string, string, MultiSetSignature> emb(s1, s2);
-    cout << (MatchEmbeds(emb) ? "True" : "False") << endl;
+  }
+
+  if ((opts.count || opts.enumerate) && (opts.timeout_ms != 0 || opts.max_decisions != 0 || opts.max_backtracks != 0)) {
+    cerr << "--count and --enumerate take no search limits, only --max-solutions" << endl;
+    return 1;
+  }
+  if (!screen.empty()) return screen_targets(screen, files, jobs, opts.embedding);
+  if (!batch.empty()) return match_batch(batch, files, jobs, opts);
+
+  unique_ptr<Cache> cache;
+  if (!cache_file.empty() && opts.embedding.homomorphism) {
+    cerr << "--cache holds embedding results only, not homomorphisms" << endl;
+    return 1;
+  } else if (!cache_file.empty() && !socket_path.empty()) {
+    cerr << "--cache cannot be used with --socket, which serves until killed" << endl;
+    return 1;
+  } else if (!cache_file.empty()) {
+    cache.reset(new Cache(cache_mb << 20));
+    struct stat st;
+    if (stat(cache_file.c_str(), &st) == 0 && !cache->load(cache_file)) {
+      cerr << cache_file << " is not a result cache" << endl;
+      return 1;
+    }
+    opts.cache = cache.get();
+  }
+
+  if (serve_stdin || !socket_path.empty()) {
+    SearchLimits limits;
+    if (opts.timeout_ms != 0) limits = SearchLimits::per_search(chrono::milliseconds(opts.timeout_ms));
+    limits.max_decisions = opts.max_decisions;
+    limits.max_backtracks = opts.max_backtracks;
+    SolverService<MultiSetSignature> service(opts.cache, opts.embedding, limits);
+    if (!socket_path.empty()) return serve_socket(service, socket_path, jobs);
+    serve(service, cin, cout);
+    if (cache && !cache->save(cache_file)) {
+      cerr << "Could not write " << cache_file << endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  ofstream stats_out;
+  if (stats_file == "-") {
+    opts.stats = &cerr;
+  } else if (!stats_file.empty()) {
+    stats_out.open(stats_file);
+    if (!stats_out) {
+      cerr << "Could not open " << stats_file << endl;
+      return 1;
+    }
+    opts.stats = &stats_out;
+  }
+
+  /* Results are printed in input order unless streaming: done[i] marks
+     instance i as finished and next is the first instance not yet printed */
+  vector<string> results(files.size());
+  vector<char> done(files.size(), 0);
+  size_t next = 0;
+  mutex out_lock;
+  MemoryBudget budget(mem_limit);
+  {
+    ThreadPool pool(jobs);
+    for (size_t i = 0; i < files.size(); ++i) {
+      pool.submit([&, i]() {
+#ifdef _OPENMP
+        if (jobs > 1) omp_set_num_threads(1); /* parallelism comes from the pool instead */
+#endif
+        /* an instance budget is enforced by the Embedding, so it bounds what the instance holds */
+        size_t bytes = budget.acquire(opts.embedding.memory_budget != 0 ? opts.embedding.memory_budget : instance_bytes(files[i]));
+        Stop_reason stop;
+        MemoryUsage memory;
+        solver_stats().clear();
+        Options o = opts;
+        if (!o.trace.empty() && files.size() > 1) o.trace += "." + to_string(i);
+        string result = solve_file(files[i], o, stop, memory);
+        budget.release(bytes);
+
+        lock_guard<mutex> lock(out_lock);
+        if (opts.stats != NULL) {
+          size_t nl = result.rfind('\n');
+          *opts.stats << "{\"file\": " << json_string(files[i])
+                      << ", \"result\": " << json_string(nl == string::npos ? result : result.substr(nl + 1))
+                      << ", \"stop_reason\": \"" << stop_reason_name(stop)
+                      << "\", \"stats\": " << solver_stats().json() << ", \"memory\": " << memory.json() << "}" << endl;
+        }
+        if (stream) {
+          if (!result.empty()) cout << files[i] << ": " << result << endl;
+          return;
+        }
+        results[i] = result;
+        done[i] = 1;
+        for (; next < files.size() && done[next]; ++next) {
+          if (!results[next].empty()) cout << results[next] << endl;
+          string().swap(results[next]);
+        }
+      });
+    }
+    pool.wait();
+  }
+  if (cache && !cache->save(cache_file)) {
+    cerr << "Could not write " << cache_file << endl;
+    return 1;
   }
 }
@@ -9,13 +9,19 @@
 
 #include <vector>
 #include <stack>
+#include <algorithm>
 #include <cstdlib>
 #include <ctime>
 #include <cassert>
+#include <functional>
 #include "definitions.h"
 #include "graph.h"
 #include "embedding.h"
 #include "selection.h"
+#include "stats.h"
+#include "limits.h"
+#include "trace.h"
+#include "components.h"
 
 #ifndef CM_MATCH_EMBEDS_H
 #define CM_MATCH_EMBEDS_H
@@ -24,19 +30,161 @@ template <class Element, class Predicate, class Signature>
 void find_conflicts(const Embedding<Element, Predicate, Signature>& e, const std::vector<int>& matching, std::vector<size_t>& confs);
 
 template <class Element, class Predicate, class Signature>
-void backtrack(Embedding<Element, Predicate, Signature>& e, std::stack<decision>& decisions);
+size_t backtrack(Embedding<Element, Predicate, Signature>& e, std::stack<decision>& decisions, bool symmetric = false,
+                 TraceSink* trace = NULL);
 
 template <class Element, class Predicate, class Signature>
-bool MatchEmbeds(Embedding<Element, Predicate, Signature>& e, Var_selection sel = MIN_REMAINING_VALUES) { /* default selection heuristic is minimum remaining values */
-  /* Remove any edges inconsistent without needing to make a decision */
-  {
-    std::vector<Graph::VertexPair> p_removed, u_removed;
-    std::vector<size_t> junk;
-    if (!e.get_universe_graph().unit_prop(u_removed, junk, junk)) return false;
-    e.filter(p_removed, u_removed);
+Search_result search_embedding(Embedding<Element, Predicate, Signature>& e, SearchLimits& limits, SearchStats& stats, Var_selection sel, TraceSink* trace);
+
+template <class Element, class Predicate, class Signature>
+Search_result search_propagated(Embedding<Element, Predicate, Signature>& e, SearchLimits& limits, SearchStats& stats, Var_selection sel,
+                                TraceSink* trace, std::stack<decision>& decisions, size_t base);
+
+template <class Element, class Predicate, class Signature>
+bool backtrack(Embedding<Element, Predicate, Signature>& e, std::stack<decision>& decisions, SearchLimits& limits, SearchStats& stats,
+               TraceSink* trace, Backtrack_reason reason);
+
+/* Give every element of a a candidate image (match1), keeping the ones
+   still in the universe graph: a total matching of the universe graph when
+   Injective, else any candidate of each element. false if there is none. */
+template <bool Injective>
+bool assign_candidates(const Graph& u_graph, std::vector<int>& match1, std::vector<int>& match2, std::vector<int>& vis) {
+  if (!Injective) {
+    for (size_t i = 0; i < match1.size(); ++i) {
+      const std::vector<Graph::Edge>& adj = u_graph.uAdj(i);
+      if (adj.empty()) return false;
+      if (match1[i] == -1 || !u_graph.has_edge(i, match1[i])) match1[i] = adj[0].vertex;
+    }
+    return true;
+  }
+  /* unmatch any edges that no longer belong to the universe graph */
+  for (size_t i = 0; i < match1.size(); ++i) {
+    if (match1[i] != -1 && !u_graph.has_edge(i, match1[i])) {
+      match2[match1[i]] = -1;
+      match1[i] = -1;
+    }
+  }
+  std::fill(vis.begin(), vis.end(), 0);                          /* reset variables for matching problem */
+  return u_graph.max_matching(match1, match2, vis) == u_graph.uSize(); /* compute maximum cardinality matching */
+}
+
+template <class Element, class Predicate, class Signature>
+bool assign_candidates(const Embedding<Element, Predicate, Signature>& e, std::vector<int>& match1, std::vector<int>& match2, std::vector<int>& vis) {
+  return e.injective() ? assign_candidates<true>(e.get_universe_graph(), match1, match2, vis)
+                       : assign_candidates<false>(e.get_universe_graph(), match1, match2, vis);
+}
+
+template <bool Injective, class Element, class Predicate, class Signature>
+Search_result search_loop(Embedding<Element, Predicate, Signature>& e, SearchLimits& limits, SearchStats& stats, Var_selection sel,
+                          TraceSink* trace, std::stack<decision>& decisions, size_t base);
+
+template <class Element, class Predicate, class Signature>
+bool solve_components(Embedding<Element, Predicate, Signature>& e, SearchLimits& limits, SearchStats& stats, Var_selection sel,
+                      TraceSink* trace, Search_result& r);
+
+/* Keep only the conflicts of the first component of a (in the order of
+   e.components()) that has any, so that decisions stay in one component
+   until it is consistent. Left alone if some conflict can no longer be
+   repaired, for select_variable to report. */
+template <class Element, class Predicate, class Signature>
+void focus_component(const Embedding<Element, Predicate, Signature>& e, std::vector<size_t>& conflicts) {
+  const PatternComponents& c = e.components();
+  if (c.members.size() < 2) return;
+  const PropTable& u_props = e.get_u_props();
+  const Graph& u_graph = e.get_universe_graph();
+  size_t first = NO_COMPONENT;
+  for (size_t i = 0; i < conflicts.size(); ++i) {
+    const size_t* vars = u_props.vars(conflicts[i]);
+    size_t k;
+    for (k = 0; k < u_props.arity(conflicts[i]) && u_graph.uAdj(vars[k]).size() <= 1; ++k);
+    if (k == u_props.arity(conflicts[i])) return;
+    first = std::min(first, c.component[vars[0]]);
+  }
+  size_t n = 0;
+  for (size_t i = 0; i < conflicts.size(); ++i) {
+    if (c.component[u_props.vars(conflicts[i])[0]] == first) conflicts[n++] = conflicts[i];
+  }
+  conflicts.resize(n);
+}
+
+/* Remove any edges inconsistent without needing to make a decision, or
+   return to the root state saved by an earlier call (see restore_root).
+   With limits, they are checked as filtering goes (reading the clock
+   between rounds); false is then also returned, with stats->stop_reason
+   set, if one is reached first. */
+template <class Element, class Predicate, class Signature>
+bool propagate_root(Embedding<Element, Predicate, Signature>& e, SearchLimits* limits = NULL, SearchStats* stats = NULL) {
+  if (stats != NULL) stats->stop_reason = NOT_STOPPED;
+  if (e.restore_root()) return e.is_valid();
+  CM_TIME_PHASE(PHASE_FILTER);
+  if (limits != NULL && limits->interrupts()) {
+    e.set_interrupt([limits, stats](bool round) {
+      return (stats->stop_reason = round ? limits->check_now(*stats) : limits->check(*stats)) != NOT_STOPPED;
+    });
+  }
+  std::vector<Graph::VertexPair> p_removed, u_removed;
+  bool valid = e.unit_prop(u_removed) && e.filter(u_removed, p_removed) && e.is_valid();
+  bool stopped = e.interrupted();
+  e.set_interrupt(std::function<bool(bool)>());
+  if (stopped) return false;
+  e.save_root(valid);
+  e.set_at_root(valid);
+  return valid;
+}
+
+/* Search for an embedding of e within limits, recording statistics in stats
+   (and the search tree in trace, if given). Returns UNKNOWN if a limit is hit
+   first (stats.stop_reason says which). */
+template <class Element, class Predicate, class Signature>
+Search_result MatchEmbeds(Embedding<Element, Predicate, Signature>& e, SearchLimits limits, SearchStats& stats,
+                          Var_selection sel = MIN_REMAINING_VALUES, TraceSink* trace = NULL) {
+  limits = limits.started();
+  Search_result r = search_embedding(e, limits, stats, sel, trace);
+  if (trace != NULL) trace->record_end(r);
+  return r;
+}
+
+template <class Element, class Predicate, class Signature>
+Search_result search_embedding(Embedding<Element, Predicate, Signature>& e, SearchLimits& limits, SearchStats& stats, Var_selection sel, TraceSink* trace) {
+  if (e.over_budget()) {
+    stats.stop_reason = MEMORY_LIMIT;
+    return UNKNOWN;
+  }
+  if (e.has_solution()) return SAT;  /* an earlier embedding survived the updates to the target */
+  Search_result r;
+  if (e.options().decompose && e.is_valid() && solve_components(e, limits, stats, sel, trace, r)) return r;
+  if (!propagate_root(e, &limits, &stats)) return stats.stop_reason != NOT_STOPPED ? UNKNOWN : UNSAT;
+  std::stack<decision> decisions;
+  return search_propagated(e, limits, stats, sel, trace, decisions, 0);
+}
+
+/* Search on top of the filtered state reached by the base decisions at the
+   bottom of the stack, which are never backtracked over (edges blamed right
+   above them are logged in the top one, so unwinding the stack restores
+   the state before them) */
+template <class Element, class Predicate, class Signature>
+Search_result search_propagated(Embedding<Element, Predicate, Signature>& e, SearchLimits& limits, SearchStats& stats, Var_selection sel,
+                                TraceSink* trace, std::stack<decision>& decisions, size_t base) {
+  /* a decision can filter for long, so a deadline or cancellation is checked as it filters too */
+  if (limits.interrupts()) {
+    e.set_interrupt([&limits, &stats](bool round) {
+      return (stats.stop_reason = round ? limits.check_now(stats) : limits.check(stats)) != NOT_STOPPED;
+    });
   }
-  if (!e.is_valid()) return false;
+  Search_result r = e.injective() ? search_loop<true>(e, limits, stats, sel, trace, decisions, base)
+                                  : search_loop<false>(e, limits, stats, sel, trace, decisions, base);
+  e.set_interrupt(std::function<bool(bool)>());
+  return r;
+}
+
+/* The search of search_propagated, for embeddings (Injective) or homomorphisms */
+template <bool Injective, class Element, class Predicate, class Signature>
+Search_result search_loop(Embedding<Element, Predicate, Signature>& e, SearchLimits& limits, SearchStats& stats, Var_selection sel,
+                          TraceSink* trace, std::stack<decision>& decisions, size_t base) {
+  if ((stats.stop_reason = limits.check(stats)) != NOT_STOPPED) return UNKNOWN;
+  CM_TIME_PHASE(PHASE_SEARCH);
   Graph& u_graph = e.get_universe_graph();
+  stats.logged = 0;
 
   srand(time(NULL));
   std::vector<size_t> conflict_history, conflicts;
@@ -45,105 +193,228 @@ bool MatchEmbeds(Embedding<Element, Predicate, Signature>& e, Var_selection sel
   std::vector<int> match1, match2, vis;
 
   match1.resize(u_graph.uSize(), -1);
-  match2.resize(u_graph.vSize(), -1);
-  vis.resize(u_graph.uSize(), 0);
-  size_t ans;
-
-  std::stack<decision> decisions;
+  match2.resize(Injective ? u_graph.vSize() : 0, -1);
+  vis.resize(Injective ? u_graph.uSize() : 0, 0);
 
   while (true) {
-    /* unmatch any edges that no longer belong to the universe graph */
-    for (size_t i = 0; i < match1.size(); ++i) {
-      if (match1[i] != -1 && !u_graph.has_edge(i, match1[i])) {
-        match2[match1[i]] = -1;
-        match1[i] = -1;
-      }
-    }
-
-    std::fill(vis.begin(), vis.end(), 0);            /* reset variables for matching problem */
-    ans = u_graph.max_matching(match1, match2, vis); /* compute maximum cardinality matching */
-
-    /* no total matching exists => backtrack */
-    if (ans != u_graph.uSize()) {
-      if(decisions.size() >= 1) {
-        backtrack(e, decisions);
+    /* no total matching (or some element without a candidate) exists => backtrack */
+    if (!assign_candidates<Injective>(u_graph, match1, match2, vis)) {
+      if(decisions.size() > base) {
+        if (!backtrack(e, decisions, limits, stats, trace, MATCHING_DEFICIT)) return UNKNOWN;
         continue;
       } else {
-        return false;
+        return UNSAT;
       }
     }
     /* find any predicates p(x0, ..., xn) that are not satisfied by candidate embedding match1 */
     find_conflicts(e, match1, conflicts);
     /* if all predicates are satisfied then the candidate is a valid embedding */
     if (conflicts.size() == 0) {
-      return true;
+      e.save_solution(match1);
+      return SAT;
     }
+    focus_component(e, conflicts);
     size_t d_edge; /* edge in match1 selected using sel heuristic */
     bool valid = select_variable(e, conflicts, sel, conflict_history, d_edge); /* valid <==> some edge can be selected <==> embedding instance is consistent */
     if (!valid) {
-      if (decisions.size() >= 1) {
-        backtrack(e, decisions);
+      if (decisions.size() > base) {
+        if (!backtrack(e, decisions, limits, stats, trace, INVALID_DECISION)) return UNKNOWN;
         continue;
       } else {
-        return false;
+        return UNSAT;
       }
     }
 
     /* make the decision that d_edge |-> match1[d_edge] */
+    ++stats.decisions;
+    if ((stats.stop_reason = limits.check(stats)) != NOT_STOPPED) return UNKNOWN;
     decisions.emplace(d_edge, match1[d_edge]);
     e.decide(decisions.top());
+    if (trace != NULL) trace->record_decision(decisions.top(), decisions.size());
+    stats.logged += decisions.top().remove_u.size() + decisions.top().remove_p.size();
+    if (e.interrupted()) return UNKNOWN;
+    if (!within_memory_budget(e, stats)) return UNKNOWN;
 
     /* if this decision was inconsistent backtrack */
     if (!e.is_valid()) {
-      backtrack(e, decisions);
+      if (!backtrack(e, decisions, limits, stats, trace, FILTER_WIPEOUT)) return UNKNOWN;
     }
   } /* continue until we find an embedding or there are no more candidate embeddings are left to explore */
 }
 
+template <class Element, class Predicate, class Signature>
+bool MatchEmbeds(Embedding<Element, Predicate, Signature>& e, Var_selection sel = MIN_REMAINING_VALUES) { /* default selection heuristic is minimum remaining values */
+  SearchStats stats;
+  return MatchEmbeds(e, SearchLimits(), stats, sel) == SAT;
+}
+
+/* Search each component of a on its own, largest first, each later one
+   (for an embedding) without the images taken by the ones before it.
+   Decides the instance (in r) as UNSAT if a component has no embedding
+   even with all of b left to it, or as SAT if every component and then
+   the isolated elements found images; otherwise (a restricted component
+   failing, or a limit hit) returns false and the whole pattern must be
+   searched, which alone reports UNKNOWN. The component searches go to
+   trace one after another, in the ids of e. Their embeddings start from
+   the candidates given to e (e.g. by a batch) if any, or else from the
+   target; the graphs e keeps for updates to b are not reused, so each
+   search after update_target builds those of the components anew. */
+template <class Element, class Predicate, class Signature>
+bool solve_components(Embedding<Element, Predicate, Signature>& e, SearchLimits& limits, SearchStats& stats, Var_selection sel,
+                      TraceSink* trace, Search_result& r) {
+  typedef Structure<Element, Predicate, Signature> Str;
+  const PatternComponents& c = e.components();
+  if (c.members.size() < 2) return false;
+  EmbeddingOptions options = e.options();
+  options.incremental = false;
+  options.reorder = false;   /* the components are of e's pattern and target, already reordered if at all */
+  const Graph& u_graph = e.get_universe_graph();
+  std::vector<int> solution(u_graph.uSize(), -1);
+  std::vector<char> used(u_graph.vSize(), 0);
+  bool restricted = false;   /* were images taken away from the component searched? */
+  /* the propositions of e in each component, in the order of component_structure */
+  const PropTable& u_props = e.get_pattern().propositions();
+  std::vector<std::vector<size_t>> props(c.members.size());
+  for (size_t p = 0; p < u_props.size(); ++p) {
+    if (u_props.arity(p) != 0) props[c.component[u_props.vars(p)[0]]].push_back(p);
+  }
+  /* candidates given to e (e.g. shared by a batch) are restricted to each component */
+  const CandidateSets* given = e.given_candidates();
+  CandidateSets sets;
+  for (size_t i = 0; i < c.members.size(); ++i) {
+    if ((stats.stop_reason = limits.check_now(stats)) != NOT_STOPPED) return false;
+    Str s = component_structure(e.get_pattern(), c, i);
+    if (given != NULL) {
+      sets.elements.clear();
+      sets.propositions.clear();
+      for (size_t j = 0; j < c.members[i].size(); ++j) sets.elements.push_back(given->elements[c.members[i][j]]);
+      for (size_t k = 0; k < props[i].size() && !given->propositions.empty(); ++k) {
+        sets.propositions.push_back(given->propositions[props[i][k]]);
+      }
+    }
+    Embedding<Element, Predicate, Signature> sub(s, e.shared_target(), options, given != NULL ? &sets : NULL);
+    if (restricted) {
+      Graph& sub_graph = sub.get_universe_graph();
+      std::vector<size_t> taken;
+      for (size_t u = 0; u < sub_graph.uSize(); ++u) {
+        taken.clear();
+        for (size_t j = 0; j < sub_graph.uAdj(u).size(); ++j) {
+          if (used[sub_graph.uAdj(u)[j].vertex]) taken.push_back(sub_graph.uAdj(u)[j].vertex);
+        }
+        for (size_t j = 0; j < taken.size(); ++j) sub_graph.remove_if_present(u, taken[j]);
+      }
+    }
+    if (trace != NULL) trace->translate(&c.members[i], &props[i]);
+    r = search_embedding(sub, limits, stats, sel, trace);
+    if (trace != NULL) {
+      trace->end_component();
+      trace->translate(NULL, NULL);
+    }
+    if (r == UNSAT && !restricted) return true;
+    if (r != SAT) return false;
+    restricted = e.injective();
+    for (size_t j = 0; j < c.members[i].size(); ++j) {
+      int v = sub.matching()[j];
+      used[v] = 1;
+      solution[c.members[i][j]] = v;
+    }
+  }
+  /* the isolated elements take the first unused candidates: they have the same candidates */
+  for (size_t i = 0; i < c.isolated.size(); ++i) {
+    size_t u = c.isolated[i];
+    const std::vector<Graph::Edge>& adj = u_graph.uAdj(u);
+    size_t j;
+    for (j = 0; j < adj.size() && e.injective() && used[adj[j].vertex]; ++j);
+    if (j == adj.size()) return false;
+    used[adj[j].vertex] = 1;
+    solution[u] = adj[j].vertex;
+  }
+  /* nullary propositions belong to no component */
+  std::vector<size_t> conflicts;
+  find_conflicts(e, solution, conflicts);
+  if (!conflicts.empty()) return false;
+  e.save_solution(solution);
+  r = SAT;
+  return true;
+}
+
+/* Count, trace and backtrack over the last decision unless a limit is reached first */
+template <class Element, class Predicate, class Signature>
+bool backtrack(Embedding<Element, Predicate, Signature>& e, std::stack<decision>& decisions, SearchLimits& limits, SearchStats& stats,
+               TraceSink* trace, Backtrack_reason reason) {
+  ++stats.backtracks;
+  if ((stats.stop_reason = limits.check(stats)) != NOT_STOPPED) return false;
+  if (trace != NULL) trace->record_backtrack(decisions.top(), decisions.size(), reason);
+  stats.logged -= decisions.top().remove_u.size() + decisions.top().remove_p.size();
+  stats.logged += backtrack(e, decisions, true, trace);
+  return true;
+}
+
+/* Record the decision logs in stats; false (stopping with MEMORY_LIMIT) if
+   they and the instance no longer fit in its memory budget */
+template <class Element, class Predicate, class Signature>
+bool within_memory_budget(const Embedding<Element, Predicate, Signature>& e, SearchStats& stats) {
+  stats.peak_logged = std::max(stats.peak_logged, stats.logged);
+  size_t budget = e.options().memory_budget;
+  if (budget == 0 || e.memory_bytes() + stats.logged * sizeof(Graph::VertexPair) <= budget) return true;
+  stats.stop_reason = MEMORY_LIMIT;
+  return false;
+}
+
 template <class Element, class Predicate, class Signature>
 void find_conflicts(const Embedding<Element, Predicate, Signature>& e, const std::vector<int>& matching, std::vector<size_t>& confs) {
-  const LabeledGraph<prop, prop>& p_graph = e.get_predicate_graph();
+  const PropTable& u_props = e.get_u_props();
+  const PropTable& v_props = e.get_v_props();
+  const TupleSet& tuples = e.get_target().tuples();
+  std::vector<size_t> image;
   confs.clear();
-  /* for each p(x0, ..., xn) */
-  for (size_t i = 0, j, k; i < p_graph.uSize(); ++i) {
-    const std::vector<Graph::Edge>& adj = p_graph.uAdj(i);
-    const std::vector<size_t>& u_vars = p_graph.getULabel(i).vars;
-    /* is there some q(y0, ..., yn) such that not (for each (xi, yi), matching[xi] = yi) */
-    for (j = 0; j < adj.size(); ++j) {
-      const std::vector<size_t>& v_vars = p_graph.getVLabel(adj[j].vertex).vars;
-      for (k = 0; k < u_vars.size() && matching[u_vars[k]] == v_vars[k]; ++k);
-      if (k == u_vars.size()) break;
-    }
-    /* if there is add p(x0, ..., xn) to the set of conflicts */
-    if (j == adj.size()) {
+  /* for each p(x0, ..., xn) such that p(matching[x0], ..., matching[xn]) is not a proposition of b */
+  for (size_t i = 0; i < u_props.size(); ++i) {
+    const size_t* u_vars = u_props.vars(i);
+    image.resize(u_props.arity(i));
+    for (size_t k = 0; k < image.size(); ++k) image[k] = matching[u_vars[k]];
+    if (tuples.find(v_props, u_props.pred(i), image.data(), image.size()) == TupleSet::npos) {
       confs.push_back(i);
     }
   }
+  CM_COUNT_N(conflicts, confs.size());
 }
 
+/* Undo the last decision and blame its edge. With symmetric set the decision
+   failed (rather than being blocked after a solution), so the edges that fail
+   by symmetry are blamed along with it (and recorded in trace, if given).
+   Returns the number of blamed edges logged in the decision below. */
 template <class Element, class Predicate, class Signature>
-void backtrack(Embedding<Element, Predicate, Signature>& e, std::stack<decision>& decisions) {
+size_t backtrack(Embedding<Element, Predicate, Signature>& e, std::stack<decision>& decisions, bool symmetric, TraceSink* trace) {
   Graph& u_graph = e.get_universe_graph();
   decision& d = decisions.top();
+  CM_COUNT(backtracks);
 
   e.add_back(d.remove_p, d.remove_u);
 
   // blame and remove (d.u |-> d.v) edge
-  size_t pos;
-  const std::vector<Graph::Edge>& adj = u_graph.uAdj(d.u);
-  for (pos = 0; pos < adj.size() && adj[pos].vertex != d.v; ++pos);
-  assert (pos < adj.size());
-  //  bool check = u_graph.check();
-  u_graph.remove_edge(d.u, pos);
-  //  assert (!check || u_graph.check()); /* ensure proper operation of edge removal */
+  std::vector<Graph::VertexPair> blamed(1, Graph::VertexPair(d.u, d.v));
+  if (symmetric) e.symmetric_failures(d.u, d.v, blamed);
+  if (trace != NULL) trace->record_blamed(blamed, 1);
+  for (size_t i = 0; i < blamed.size(); ++i) {
+    size_t pos;
+    const std::vector<Graph::Edge>& adj = u_graph.uAdj(blamed[i].u);
+    for (pos = 0; pos < adj.size() && adj[pos].vertex != blamed[i].v; ++pos);
+    assert (pos < adj.size());
+    //  bool check = u_graph.check();
+    u_graph.remove_edge(blamed[i].u, pos);
+    //  assert (!check || u_graph.check()); /* ensure proper operation of edge removal */
+  }
 
   decisions.pop();
 
-  /* if this isn't the root decision it is possible for the edge (d.u, d.v) to belong to an embedding */
+  /* if this isn't the root decision it is possible for the blamed edges to belong to an embedding */
   if (decisions.size() > 0) {
     decision& prev = decisions.top();
-    prev.remove_u.emplace_back(d.u, d.v);
+    prev.remove_u.insert(prev.remove_u.end(), blamed.begin(), blamed.end());
+    return blamed.size();
   }
+  return 0;
 }
 
 #endif
@@ -0,0 +1,69 @@
+/*****************************************************************************
+  Author: Charlie Murphy
+  Email:  tcm3@cs.princeton.edu
+
+  Date:   October 18, 2026
+
+  Description: Cheap necessary conditions for an embedding to exist,
+    checked on the structures before the universe and predicate graphs are
+    built. An embedding is injective on elements and therefore on tuples,
+    and maps each occurrence of an element in a tuple to an occurrence of
+    its image, so a cannot embed into b if it has more elements, more tuples
+    of some relation, or a degree sequence not dominated by b's.
+ *****************************************************************************/
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include "structure.h"
+#include "target.h"
+#include "definitions.h"
+
+#ifndef CM_PRECHECK_H
+#define CM_PRECHECK_H
+
+/* a has at most as many elements as b */
+template <class Element, class Predicate, class Signature>
+bool check_universe_sizes(const Structure<Element, Predicate, Signature>& a, const Target<Element, Predicate, Signature>& b) {
+  return a.universe_size() <= b.universe_size();
+}
+
+/* a has at most as many tuples of each relation as b */
+template <class Element, class Predicate, class Signature>
+bool check_tuple_counts(const Structure<Element, Predicate, Signature>& a, const Target<Element, Predicate, Signature>& b) {
+  const PropTable& props = a.propositions();
+  if (props.size() > b.props().size()) return false;
+  std::vector<size_t> counts;
+  for (size_t i = 0; i < props.size(); ++i) {
+    size_t q = props.pred(i);
+    if (counts.size() <= q) counts.resize(q + 1, 0);
+    if (++counts[q] > b.pred_props(q).size()) return false;
+  }
+  return true;
+}
+
+/* The i-th largest degree of a is at most the i-th largest degree of b, for every i */
+template <class Element, class Predicate, class Signature>
+bool check_degrees(const Structure<Element, Predicate, Signature>& a, const Target<Element, Predicate, Signature>& b) {
+  const PropTable& props = a.propositions();
+  std::vector<size_t> degrees(a.universe_size(), 0);
+  for (size_t i = 0; i < props.size(); ++i) {
+    const size_t* vars = props.vars(i);
+    for (size_t k = 0; k < props.arity(i); ++k) ++degrees[vars[k]];
+  }
+  std::sort(degrees.begin(), degrees.end(), std::greater<size_t>());
+  const std::vector<size_t>& b_degrees = b.degree_sequence();
+  if (degrees.size() > b_degrees.size()) return false;
+  for (size_t i = 0; i < degrees.size(); ++i) {
+    if (degrees[i] > b_degrees[i]) return false;
+  }
+  return true;
+}
+
+/* false if a certainly does not embed into b */
+template <class Element, class Predicate, class Signature>
+bool precheck(const Structure<Element, Predicate, Signature>& a, const Target<Element, Predicate, Signature>& b) {
+  return check_universe_sizes(a, b) && check_tuple_counts(a, b) && check_degrees(a, b);
+}
+
+#endif
@@ -35,12 +35,12 @@ enum Var_selection {
 template <class Element, class Predicate, class Signature>
 bool select_variable(const Embedding<Element, Predicate, Signature>& e, const std::vector<size_t>& conflicts, Var_selection sel, std::vector<size_t>& conflict_history, size_t& d_edge) {
   const Graph& u_graph = e.get_universe_graph();
-  const LabeledGraph<prop, prop>& p_graph = e.get_predicate_graph();
+  const PropTable& u_props = e.get_u_props();
 
   /* select the first valid decision edge */
   if (sel == FIRST_VAR) {
-    const std::vector<size_t> & cvars = p_graph.getULabel(conflicts[0]).vars;
-    for (size_t i = 0; i < cvars.size(); ++i) {
+    const size_t* cvars = u_props.vars(conflicts[0]);
+    for (size_t i = 0; i < u_props.arity(conflicts[0]); ++i) {
       if (u_graph.uAdj(cvars[i]).size() > 1) {
         d_edge = cvars[i];
         return true;
@@ -51,9 +51,9 @@ bool select_variable(const Embedding<Element, Predicate, Signature>& e, const st
   } else if (sel == WEIGHTED_RANDOM_VAR) {
     std::vector<size_t> vars;
     for (size_t i = 0; i < conflicts.size(); ++i) {
-      const std::vector<size_t>& cvars = p_graph.getULabel(conflicts[i]).vars;
+      const size_t* cvars = u_props.vars(conflicts[i]);
       bool valid(false);
-      for (size_t j = 0; j < cvars.size(); ++j) {
+      for (size_t j = 0; j < u_props.arity(conflicts[i]); ++j) {
         if (u_graph.uAdj(cvars[j]).size() > 1) {
           vars.push_back(cvars[j]);
           valid = true;
@@ -67,9 +67,9 @@ bool select_variable(const Embedding<Element, Predicate, Signature>& e, const st
   } else if (sel == UNIFORM_RANDOM_VAR) {
     std::set<size_t> vars;
     for (size_t i = 0; i < conflicts.size(); ++i) {
-      const std::vector<size_t>& cvars = p_graph.getULabel(conflicts[i]).vars;
+      const size_t* cvars = u_props.vars(conflicts[i]);
       bool valid(false);
-      for (size_t j = 0; j < cvars.size(); ++j) {
+      for (size_t j = 0; j < u_props.arity(conflicts[i]); ++j) {
         if (u_graph.uAdj(cvars[j]).size() > 1) {
           vars.insert(cvars[j]);
           valid = true;
@@ -89,9 +89,9 @@ bool select_variable(const Embedding<Element, Predicate, Signature>& e, const st
   /* Compute heuristic value for Remaining Values heuristic */
   if (sel == MIN_REMAINING_VALUES || sel == MAX_REMAINING_VALUES) {
     for (size_t i = 0; i < conflicts.size(); ++i) {
-      const std::vector<size_t>& cvars = p_graph.getULabel(conflicts[i]).vars;
+      const size_t* cvars = u_props.vars(conflicts[i]);
       bool valid(false);
-      for (size_t j = 0; j < cvars.size(); ++j) {
+      for (size_t j = 0; j < u_props.arity(conflicts[i]); ++j) {
         if (u_graph.uAdj(cvars[j]).size() > 1) {
           vars[cvars[j]] = u_graph.uAdj(cvars[j]).size();
           valid = true;
@@ -102,9 +102,9 @@ bool select_variable(const Embedding<Element, Predicate, Signature>& e, const st
   /* Compute number of conflicts each decision variable is involved in */
   } else if (sel == MIN_CONFLICTS || sel == MAX_CONFLICTS) {
     for (size_t i = 0; i < conflicts.size(); ++i) {
-      const std::vector<size_t>& cvars = p_graph.getULabel(conflicts[i]).vars;
+      const size_t* cvars = u_props.vars(conflicts[i]);
       bool valid(false);
-      for (size_t j = 0; j < cvars.size(); ++j) {
+      for (size_t j = 0; j < u_props.arity(conflicts[i]); ++j) {
         if (u_graph.uAdj(cvars[j]).size() > 1) {
           ++vars[cvars[j]];
           valid = true;
@@ -115,9 +115,9 @@ bool select_variable(const Embedding<Element, Predicate, Signature>& e, const st
   /* Update conflict history of each decision variable and use as heuristic value */
   } else { // sel == MIN_CONFLICT_HISTORY || sel == MAX_CONFLICT_HISTORY
     for (size_t i = 0; i < conflicts.size(); ++i) {
-      const std::vector<size_t>& cvars = p_graph.getULabel(conflicts[i]).vars;
+      const size_t* cvars = u_props.vars(conflicts[i]);
       bool valid(false);
-      for (size_t j = 0; j < cvars.size(); ++j) {
+      for (size_t j = 0; j < u_props.arity(conflicts[i]); ++j) {
         if (u_graph.uAdj(cvars[j]).size() > 1) {
           vars[cvars[j]] = ++conflict_history[cvars[j]];
           valid = true;
@@ -0,0 +1,114 @@
+/*****************************************************************************
+  Author: Charlie Murphy
+  Email:  tcm3@cs.princeton.edu
+
+  Date:   October 18, 2026
+
+  Description: Line oriented solver service that keeps preprocessed target
+    structures resident between queries. Requests:
+
+      load NAME FILE    preprocess the (first) structure in FILE as target NAME
+      unload NAME       forget target NAME
+      query NAME FILE   does the (first) structure in FILE embed into NAME?
+
+    Each request produces one line of response: "ok", "True", "False",
+    "Unknown" (a limit was reached) or "error: <reason>". Targets are
+    preprocessed and queries solved with the options and limits the service
+    was created with. Requests may be handled concurrently. With a result
+    cache, queries repeating an earlier one up to renaming are answered
+    from it.
+ *****************************************************************************/
+
+#include <string>
+#include <sstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include "structure.h"
+#include "target.h"
+#include "embedding.h"
+#include "match_embeds.h"
+#include "formats.h"
+#include "cache.h"
+
+#ifndef CM_SERVICE_H
+#define CM_SERVICE_H
+
+template <class Signature>
+class SolverService {
+  public:
+    typedef Structure<std::string, std::string, Signature> Str;
+    typedef Target<std::string, std::string, Signature> Tgt;
+    typedef ResultCache<std::string, std::string, Signature> Cache;
+
+    /* A budget in limits (SearchLimits::per_search) is given to each query */
+    explicit SolverService(Cache* cache = NULL, const EmbeddingOptions& options = EmbeddingOptions(),
+                           const SearchLimits& limits = SearchLimits()) :
+      cache_(cache), options_(options), limits_(limits) {}
+
+    /* Handle a single request line and return the response line */
+    std::string handle(const std::string& line) {
+      std::istringstream ins(line);
+      std::string cmd, name, file;
+      ins >> cmd >> name;
+      if (cmd == "load" && ins >> file) {
+        bool valid = true;
+        std::shared_ptr<Str> b = std::make_shared<Str>(read_structure<Signature>(file, valid));
+        if (!valid) return "error: could not read a structure from " + file;
+        std::shared_ptr<const Tgt> t = std::make_shared<const Tgt>(std::shared_ptr<const Str>(b),
+                                                                   options_.reorder && !options_.incremental);
+        std::shared_ptr<const CanonicalForm> f;
+        if (cache_ != NULL) f = std::make_shared<const CanonicalForm>(canonical_form(*b));
+        std::lock_guard<std::mutex> lock(mutex_);
+        targets_[name] = Resident(t, f);
+        return "ok";
+      } else if (cmd == "unload" && !name.empty()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return targets_.erase(name) ? "ok" : "error: no target " + name;
+      } else if (cmd == "query" && ins >> file) {
+        /* the target and its form are fetched together, so a concurrent
+           load of the same name cannot pair one with the other's result */
+        Resident res = resident(name);
+        std::shared_ptr<const Tgt> t = res.first;
+        if (!t) return "error: no target " + name;
+        bool valid = true;
+        Str a = read_structure<Signature>(file, valid);
+        if (!valid) return "error: could not read a structure from " + file;
+        std::shared_ptr<const CanonicalForm> f = res.second;
+        CanonicalForm fa;
+        Search_result r;
+        if (f) {
+          fa = canonical_form(a);
+          if (cache_->lookup(fa, *f, r)) return r == SAT ? "True" : "False";
+        }
+        Embedding<std::string, std::string, Signature> emb(a, t, options_);
+        SearchStats stats;
+        r = MatchEmbeds(emb, limits_.started(), stats);
+        if (f) cache_->store(fa, *f, r, emb.solution());
+        return r == SAT ? "True" : (r == UNSAT ? "False" : "Unknown");
+      }
+      return "error: unknown request";
+    }
+
+    std::shared_ptr<const Tgt> target(const std::string& name) {
+      return resident(name).first;
+    }
+
+  private:
+    /* a target and, with a cache, its canonical form */
+    typedef std::pair<std::shared_ptr<const Tgt>, std::shared_ptr<const CanonicalForm>> Resident;
+
+    std::mutex mutex_;
+    std::map<std::string, Resident> targets_;
+    Cache* cache_;
+    const EmbeddingOptions options_;
+    const SearchLimits limits_;
+
+    Resident resident(const std::string& name) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      typename std::map<std::string, Resident>::iterator it = targets_.find(name);
+      return it == targets_.end() ? Resident() : it->second;
+    }
+};
+
+#endif
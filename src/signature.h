@@ -11,26 +11,83 @@
     available API:
 
     Signature(size_t self);
-    void update_signature(size_t predicate, std::vector<size_t> vars, size_t position);
+    void update_signature(size_t predicate, const size_t* vars, size_t arity, size_t position);
     bool operator < (const Signature& other) const;
+    size_t memory_bytes() const;  // heap bytes held, for memory accounting
+
+    Signatures used to find homomorphisms (which need not be injective)
+    additionally implement:
+
+    bool occurs_within(const Signature& other) const;  // other occurs wherever this does
+
+    Structures whose propositions are removed additionally implement:
+
+    void remove_from_signature(size_t predicate, const size_t* vars, size_t arity, size_t position);
+
+    Signatures stored in binary structure files additionally implement:
+
+    void write(std::vector<uint64_t>& out) const;
+    const uint64_t* read(const uint64_t* in, const uint64_t* end);  // returns the end of the signature, NULL if it overruns end
  *********************************************************************/
 
 #include <vector>
+#include <cstdint>
+
+#ifndef CM_SIGNATURE_H
+#define CM_SIGNATURE_H
 
 /* This signature records the multiset of positions within a relation
    this element appears in optimized for densely packed structures */
 class MultiSetSignature {
  public:
-  MultiSetSignature(size_t self) {}
+  MultiSetSignature(size_t /*self*/) {}
 
-  void update_signature(size_t predicate, std::vector<size_t> vars, size_t pos) {
+  void update_signature(size_t predicate, const size_t* /*vars*/, size_t arity, size_t pos) {
     if (occurences.size() < predicate + 1) {
       occurences.resize(predicate + 1);
-      occurences[predicate].resize(vars.size(), 0);
+    }
+    if (occurences[predicate].size() < arity) {
+      occurences[predicate].resize(arity, 0);
     }
     ++occurences[predicate][pos];
   }
 
+  /* Undo update_signature for a proposition that is removed */
+  void remove_from_signature(size_t predicate, const size_t* /*vars*/, size_t /*arity*/, size_t pos) {
+    --occurences[predicate][pos];
+  }
+
+  size_t memory_bytes() const {
+    size_t bytes = occurences.capacity() * sizeof(std::vector<size_t>);
+    for (size_t i = 0; i < occurences.size(); ++i) bytes += occurences[i].capacity() * sizeof(size_t);
+    return bytes;
+  }
+
+  void write(std::vector<uint64_t>& out) const {
+    out.push_back(occurences.size());
+    for (size_t i = 0; i < occurences.size(); ++i) {
+      out.push_back(occurences[i].size());
+      out.insert(out.end(), occurences[i].begin(), occurences[i].end());
+    }
+  }
+
+  const uint64_t* read(const uint64_t* in, const uint64_t* end) {
+    if (in == end || *in > (uint64_t) (end - in - 1)) return NULL;
+    occurences.resize(*in++);
+    for (size_t i = 0; i < occurences.size(); ++i) {
+      if (in == end || *in > (uint64_t) (end - in - 1)) return NULL;
+      size_t n = *in++;
+      occurences[i].assign(in, in + n);
+      in += n;
+    }
+    return in;
+  }
+
+  /* A total order (lexicographic on the counts), for keying maps by signature */
+  bool operator < (const MultiSetSignature& other) const {
+    return occurences < other.occurences;
+  }
+
   bool operator <= (const MultiSetSignature& other) const {
     bool subset = occurences.size() <= other.occurences.size();
     for (size_t i = 0; subset && i < occurences.size(); ++i) {
@@ -42,6 +99,22 @@ class MultiSetSignature {
     return subset;
   }
 
+  /* Does other occur at every (relation, position) this does? Unlike <=
+     the numbers of occurrences do not matter, since a homomorphism may map
+     several tuples onto one. */
+  bool occurs_within(const MultiSetSignature& other) const {
+    for (size_t i = 0; i < occurences.size(); ++i) {
+      for (size_t j = 0; j < occurences[i].size(); ++j) {
+        if (occurences[i][j] != 0 && (i >= other.occurences.size() || j >= other.occurences[i].size() || other.occurences[i][j] == 0)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
  private:
   std::vector<std::vector<size_t>> occurences;
 };
+
+#endif
@@ -0,0 +1,185 @@
+/*****************************************************************************
+  Author: Charlie Murphy
+  Email:  tcm3@cs.princeton.edu
+
+  Date:   October 18, 2026
+
+  Description: Statistics gathered while searching for an embedding
+
+    SearchStats describes one (limited) search. MemoryUsage breaks down the
+    bytes held by an embedding instance. SolverStats counts the work
+    done in the hot loops of the solver and times its phases; it is kept per
+    thread and updated through the CM_COUNT / CM_TIME_PHASE macros, which
+    compile to nothing when CM_NO_STATS is defined.
+ *****************************************************************************/
+
+#include <cstddef>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <sstream>
+
+#ifndef CM_STATS_H
+#define CM_STATS_H
+
+/* Why a search gave up before deciding the instance */
+enum Stop_reason {
+  NOT_STOPPED = 0,
+  DEADLINE,
+  DECISION_LIMIT,
+  BACKTRACK_LIMIT,
+  CANCELLED,
+  MEMORY_LIMIT,     // the instance outgrew EmbeddingOptions::memory_budget
+};
+
+struct SearchStats {
+  SearchStats() : decisions(0), backtracks(0), stop_reason(NOT_STOPPED), logged(0), peak_logged(0) {}
+  size_t decisions;
+  size_t backtracks;
+  Stop_reason stop_reason;
+  size_t logged;        /* edge removals logged by the open decisions */
+  size_t peak_logged;   /* the most of them at once */
+};
+
+inline const char* stop_reason_name(Stop_reason r) {
+  switch (r) {
+    case DEADLINE: return "deadline";
+    case DECISION_LIMIT: return "decision_limit";
+    case BACKTRACK_LIMIT: return "backtrack_limit";
+    case CANCELLED: return "cancelled";
+    case MEMORY_LIMIT: return "memory_limit";
+    default: return "none";
+  }
+}
+
+/* Heap bytes held by a vector, and by a vector of vectors (by capacity) */
+template <class T>
+size_t heap_bytes(const std::vector<T>& v) {
+  return v.capacity() * sizeof(T);
+}
+
+template <class T>
+size_t heap_bytes(const std::vector<std::vector<T>>& v) {
+  size_t bytes = v.capacity() * sizeof(std::vector<T>);
+  for (size_t i = 0; i < v.size(); ++i) bytes += heap_bytes(v[i]);
+  return bytes;
+}
+
+/* Heap bytes held by an embedding instance, by the capacity of its
+   containers (allocator overhead is not counted). The structures are
+   reported apart: the pattern belongs to the caller and the target may be
+   shared by many instances. */
+struct MemoryUsage {
+  MemoryUsage() : universe_graph(0), predicate_graph(0), labels(0), saved_graphs(0), decisions(0),
+                  pattern(0), target(0), lazy_fallback(false) {}
+  size_t universe_graph;
+  size_t predicate_graph;
+  size_t labels;          /* inverse labels, lazy supports and symmetry marks */
+  size_t saved_graphs;    /* copies kept for incremental updates */
+  size_t decisions;       /* logs of the open decisions at their largest (from SearchStats::peak_logged) */
+  size_t pattern;         /* propositions, signatures and names of a */
+  size_t target;          /* b and its indexes */
+  bool lazy_fallback;     /* the predicate graph was dropped to stay within the budget */
+
+  /* The bytes held by the instance itself */
+  size_t total() const { return universe_graph + predicate_graph + labels + saved_graphs + decisions; }
+
+  /* A single line JSON object */
+  std::string json() const {
+    std::ostringstream outs;
+    outs << "{\"total\": " << total() << ", \"universe_graph\": " << universe_graph
+         << ", \"predicate_graph\": " << predicate_graph << ", \"labels\": " << labels
+         << ", \"saved_graphs\": " << saved_graphs << ", \"decisions\": " << decisions
+         << ", \"pattern\": " << pattern << ", \"target\": " << target
+         << ", \"lazy_fallback\": " << (lazy_fallback ? "true" : "false") << "}";
+    return outs.str();
+  }
+};
+
+/* Timed phases of solving an instance */
+enum Phase {
+  PHASE_READ = 0,      // parsing, including the incremental signature updates
+  PHASE_SIGNATURES,    // partitioning the structures into signature and symmetry classes
+  PHASE_FILL_U_GRAPH,
+  PHASE_FILL_P_GRAPH,
+  PHASE_FILTER,        // propagation at the root
+  PHASE_SEARCH,
+  NUM_PHASES,
+};
+
+/* Work done by the solver. Plain data so that the per thread instance needs
+   no initialization guard. */
+struct SolverStats {
+  size_t decisions;
+  size_t backtracks;
+  size_t matchings;       /* max_matching calls */
+  size_t augment_steps;   /* vertices visited looking for augmenting paths */
+  size_t filter_calls;    /* filter_one calls */
+  size_t edges_removed;   /* edges removed from the universe and predicate graphs */
+  size_t unit_props;      /* edges committed because they were the only choice left */
+  size_t conflicts;       /* predicates violated by candidate matchings */
+  double seconds[NUM_PHASES];
+
+  void clear() { *this = SolverStats(); }
+
+  void add(const SolverStats& s) {
+    decisions += s.decisions;
+    backtracks += s.backtracks;
+    matchings += s.matchings;
+    augment_steps += s.augment_steps;
+    filter_calls += s.filter_calls;
+    edges_removed += s.edges_removed;
+    unit_props += s.unit_props;
+    conflicts += s.conflicts;
+    for (size_t i = 0; i < NUM_PHASES; ++i) seconds[i] += s.seconds[i];
+  }
+
+  /* A single line JSON object */
+  std::string json() const {
+    static const char* phases[NUM_PHASES] = {"read", "signatures", "fill_u_graph", "fill_p_graph", "filter", "search"};
+    std::ostringstream outs;
+    outs << "{\"decisions\": " << decisions << ", \"backtracks\": " << backtracks
+         << ", \"matchings\": " << matchings << ", \"augment_steps\": " << augment_steps
+         << ", \"filter_calls\": " << filter_calls << ", \"edges_removed\": " << edges_removed
+         << ", \"unit_props\": " << unit_props << ", \"conflicts\": " << conflicts << ", \"seconds\": {";
+    for (size_t i = 0; i < NUM_PHASES; ++i) {
+      outs << (i == 0 ? "" : ", ") << "\"" << phases[i] << "\": " << seconds[i];
+    }
+    outs << "}}";
+    return outs.str();
+  }
+};
+
+/* The statistics of the calling thread */
+inline SolverStats& solver_stats() {
+  static thread_local SolverStats stats;
+  return stats;
+}
+
+/* Adds the time until it goes out of scope to a phase of solver_stats() */
+class PhaseTimer {
+ public:
+  explicit PhaseTimer(Phase phase) : phase_(phase), start_(std::chrono::steady_clock::now()) {}
+  ~PhaseTimer() {
+    solver_stats().seconds[phase_] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+  }
+
+ private:
+  Phase phase_;
+  std::chrono::steady_clock::time_point start_;
+
+  PhaseTimer(const PhaseTimer&);
+  PhaseTimer& operator = (const PhaseTimer&);
+};
+
+#ifdef CM_NO_STATS
+#define CM_COUNT(counter) ((void) 0)
+#define CM_COUNT_N(counter, n) ((void) 0)
+#define CM_TIME_PHASE(phase) ((void) 0)
+#else
+#define CM_COUNT(counter) (++solver_stats().counter)
+#define CM_COUNT_N(counter, n) (solver_stats().counter += (n))
+#define CM_TIME_PHASE(phase) PhaseTimer cm_phase_timer_(phase)
+#endif
+
+#endif
@@ -10,8 +10,11 @@
 #include <iostream>
 #include <map>
 #include <vector>
-#include <set>
+#include <deque>
+#include <mutex>
 #include <utility>
+#include <cassert>
+#include "definitions.h"
 
 #ifndef CM_STRUCTURE_H
 #define CM_STRUCTURE_H
@@ -19,11 +22,28 @@
 template <class Element, class Predicate, class Signature>
 class Embedding;
 
+template <class Signature>
+class BinaryStructReader;
+
+/* How a structure changed since its changes were last taken, so that what was
+   computed from it can be updated instead of rebuilt */
+struct StructureChanges {
+  StructureChanges() : serial(0), universe_size(0), size(0) {}
+  size_t serial;                 /* number of the change set: take_changes counts them from 1 */
+  size_t universe_size;          /* elements before the changes (later ones are new) */
+  size_t size;                   /* propositions before the changes */
+  std::vector<size_t> renumber;  /* index now of each of those propositions (npos if removed), empty if none was removed */
+  std::vector<size_t> touched;   /* elements whose signature changed, possibly repeated */
+};
+
 /* Definition of Structure */
 template <class Element, class Predicate, class Signature>
 class Structure {
  public:
+  Structure() : tracking(false), taken(0) {}
+
   void add_element(const Element& e) {
+    sync_universe();
     if (universe.find(e) == universe.end()) {
       universe.emplace(e, universe.size());
       elements.push_back(e);
@@ -31,14 +51,29 @@ class Structure {
     }
   }
 
-  static void add_relation(const Predicate& p) {
-    if (rel_symbols.find(p) == rel_symbols.end()) {
-      rel_symbols.emplace(p, rel_symbols.size());
+  /* Adds e, known to be new, as element id == universe_size(): for readers
+     that intern the names themselves. The name map is left to be rebuilt
+     on first use, as for a structure loaded in bulk. */
+  void add_element(Element e, size_t id) {
+    assert(id == elements.size());
+    elements.push_back(std::move(e));
+    signatures.push_back(Signature(id));
+  }
+
+  /* Adds the relation symbol p (if new) and returns its id. Relation symbols
+     are shared by every structure, so access to them is serialized. */
+  static size_t add_relation(const Predicate& p) {
+    std::lock_guard<std::mutex> lock(relation_lock());
+    typename std::map<Predicate, size_t>::iterator it = rel_symbols.find(p);
+    if (it == rel_symbols.end()) {
+      it = rel_symbols.emplace(p, rel_symbols.size()).first;
       predicates.push_back(p);
     }
+    return it->second;
   }
 
   void add_proposition(const Predicate& p, const std::vector<Element>& vars) {
+    sync_universe();
     std::vector<size_t> uvars;
     for (size_t i = 0; i < vars.size(); ++i) {
       if (universe.find(vars[i]) == universe.end()) {
@@ -46,26 +81,132 @@ class Structure {
       }
       uvars.push_back(universe[vars[i]]);
     }
-    if (rel_symbols.find(p) == rel_symbols.end()) {
-      add_relation(p);
+    add_proposition(add_relation(p), uvars.data(), uvars.size());
+  }
+
+  /* Add the proposition q(uvars[0], ..., uvars[n-1]) where q is a relation symbol
+     id and each uvars[i] is an element id already in the universe */
+  void add_proposition(size_t q, const size_t* uvars, size_t n) {
+    if (index.size() != props.size()) {
+      index.build(props);
+    }
+    if (index.find(props, q, uvars, n) == TupleSet::npos) {
+      size_t id = props.push_back(q, uvars, n);
+      index.insert(props, id);
+      for (size_t i = 0; i < n; ++i) {
+        signatures[uvars[i]].update_signature(q, uvars, n, i);
+      }
+      if (tracking) changes.touched.insert(changes.touched.end(), uvars, uvars + n);
+    }
+  }
+
+  /* Index of the proposition q(uvars[0], ..., uvars[n-1]), or npos if there is none */
+  size_t find_proposition(size_t q, const size_t* uvars, size_t n) {
+    if (index.size() != props.size()) {
+      index.build(props);
     }
-    size_t q = rel_symbols[p];
-    if (relations[q].find(uvars) == relations[q].end()) { /* relies on fact that [] notation initializes to empty set if not already in map */
-      relations[q].insert(uvars);
-      for (size_t i = 0; i < uvars.size(); ++i) {
-        signatures[uvars[i]].update_signature(q, uvars, i);
+    return index.find(props, q, uvars, n);
+  }
+
+  /* Remove p(vars) if it is a proposition; returns whether it was */
+  bool remove_proposition(const Predicate& p, const std::vector<Element>& vars) {
+    sync_universe();
+    std::vector<size_t> uvars;
+    for (size_t i = 0; i < vars.size(); ++i) {
+      typename std::map<Element, size_t>::const_iterator it = universe.find(vars[i]);
+      if (it == universe.end()) return false;
+      uvars.push_back(it->second);
+    }
+    size_t id = find_proposition(add_relation(p), uvars.data(), uvars.size());
+    if (id == TupleSet::npos) return false;
+    remove_propositions(std::vector<size_t>(1, id));
+    return true;
+  }
+
+  /* Remove the propositions with the given indices; the remaining ones keep
+     their order, moving down over the gaps. Linear in the size of the structure. */
+  void remove_propositions(const std::vector<size_t>& ids) {
+    std::vector<char> dead(props.size(), 0);
+    for (size_t i = 0; i < ids.size(); ++i) {
+      if (dead[ids[i]]) continue;
+      dead[ids[i]] = 1;
+      size_t q = props.pred(ids[i]), n = props.arity(ids[i]);
+      const size_t* uvars = props.vars(ids[i]);
+      for (size_t k = 0; k < n; ++k) {
+        signatures[uvars[k]].remove_from_signature(q, uvars, n, k);
       }
+      if (tracking) changes.touched.insert(changes.touched.end(), uvars, uvars + n);
+    }
+    std::vector<size_t> renumber = props.erase(dead);
+    index.build(props);
+    if (!tracking) return;
+    if (changes.renumber.empty()) {
+      changes.renumber.resize(changes.size);
+      for (size_t i = 0; i < changes.size; ++i) changes.renumber[i] = i;
+    }
+    for (size_t i = 0; i < changes.renumber.size(); ++i) {
+      if (changes.renumber[i] != TupleSet::npos) changes.renumber[i] = renumber[changes.renumber[i]];
     }
   }
 
+  /* Start recording changes (see take_changes) */
+  void track_changes() {
+    tracking = true;
+    take_changes();
+  }
+
+  /* The changes since track_changes or the last take_changes */
+  StructureChanges take_changes() {
+    StructureChanges c = changes;
+    c.serial = ++taken;
+    changes = StructureChanges();
+    changes.universe_size = elements.size();
+    changes.size = props.size();
+    return c;
+  }
+
+  /* Number of change sets taken so far, and are there changes not taken yet? */
+  size_t changes_taken() const { return taken; }
+  bool has_changes() const {
+    return tracking && (changes.universe_size != elements.size() || changes.size != props.size() || !changes.renumber.empty()
+                        || !changes.touched.empty());
+  }
+
   size_t universe_size() const {
-    return universe.size();
+    return elements.size();
   }
 
   const Signature& get_signature(size_t u) const {
     return signatures[u];
   }
 
+  const Element& element(size_t u) const {
+    return elements[u];
+  }
+
+  static size_t num_relations() {
+    std::lock_guard<std::mutex> lock(relation_lock());
+    return predicates.size();
+  }
+
+  static const Predicate& relation(size_t q) {
+    std::lock_guard<std::mutex> lock(relation_lock());
+    return predicates[q];
+  }
+
+  /* Heap bytes held by the propositions, their index and the elements with
+     their signatures (not counting the names map or heap data of names) */
+  size_t memory_bytes() const {
+    size_t bytes = props.memory_bytes() + index.memory_bytes() + heap_bytes(elements) + heap_bytes(signatures);
+    for (size_t u = 0; u < signatures.size(); ++u) bytes += signatures[u].memory_bytes();
+    return bytes;
+  }
+
+  /* All propositions of the structure in insertion order */
+  const PropTable& propositions() const {
+    return props;
+  }
+
   friend std::ostream& operator << (std::ostream& outs, const Structure& s) {
     outs << "Universe: {";
     for (size_t i = 0; i < s.elements.size(); ++i) {
@@ -76,37 +217,56 @@ class Structure {
     }
     outs << "}" << std::endl;
 
-    for (auto it = s.relations.begin(); it != s.relations.end(); ++it) {
-      for (auto sit = it->second.begin(); sit != it->second.end(); ++sit) {
-        outs << predicates[it->first] << "(";
-        for (size_t i = 0; i < sit->size(); ++i) {
-          if (i != 0) {
-            outs << ", ";
-          }
-          outs << s.elements[sit->at(i)];
+    for (size_t j = 0; j < s.props.size(); ++j) {
+      outs << relation(s.props.pred(j)) << "(";
+      const size_t* vars = s.props.vars(j);
+      for (size_t i = 0; i < s.props.arity(j); ++i) {
+        if (i != 0) {
+          outs << ", ";
         }
-        outs << ")" << std::endl;
+        outs << s.elements[vars[i]];
       }
+      outs << ")" << std::endl;
     }
     return outs;
   }
 
   friend  Embedding<Element, Predicate, Signature>;
+  template <class S> friend class BinaryStructReader;
 
  private:
-  std::map<Element, size_t> universe;
+  std::map<Element, size_t> universe;  /* built on first use for structures loaded in bulk */
   std::vector<Element> elements;       /* reverse map of universe */
   std::vector<Signature> signatures;   /* signature of each universe element */
 
+  /* Rebuild the name map if elements were loaded without it */
+  void sync_universe() {
+    if (universe.size() != elements.size()) {
+      universe.clear();
+      for (size_t i = 0; i < elements.size(); ++i) {
+        universe.emplace(elements[i], i);
+      }
+    }
+  }
+
   static std::map<Predicate, size_t> rel_symbols;   /* Shared across all instances of this structure type */
-  static std::vector<Predicate> predicates;         /* reverse map of rel_symbols */
-  std::map<size_t, std::set<std::vector<size_t>>> relations;
+  static std::deque<Predicate> predicates;          /* reverse map of rel_symbols (references stay valid as it grows) */
+
+  static std::mutex& relation_lock() {
+    static std::mutex m;
+    return m;
+  }
+  PropTable props;                     /* every proposition p(x0, ..., xn) of the structure */
+  TupleSet index;                      /* membership index over props (built on first use) */
+  bool tracking;                       /* record changes? */
+  StructureChanges changes;            /* since tracking started or changes were last taken */
+  size_t taken;                        /* change sets taken */
 };
 
 template <class Element, class Predicate, class Signature>
 std::map<Predicate, size_t> Structure<Element, Predicate, Signature>::rel_symbols;
 
 template <class Element, class Predicate, class Signature>
-std::vector<Predicate> Structure<Element, Predicate, Signature>::predicates;
+std::deque<Predicate> Structure<Element, Predicate, Signature>::predicates;
 
 #endif
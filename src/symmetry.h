@@ -0,0 +1,124 @@
+/*****************************************************************************
+  Author: Charlie Murphy
+  Email:  tcm3@cs.princeton.edu
+
+  Date:   October 18, 2026
+
+  Description: Interchangeable elements of a structure. Elements v and w
+    are interchangeable when swapping them maps every proposition to a
+    proposition, i.e. the transposition (v w) is an automorphism. This is an
+    equivalence relation, so the elements split into classes; any solution
+    stays a solution when interchangeable elements are swapped, which the
+    search uses to prune symmetric values after a failed decision.
+ *****************************************************************************/
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include "definitions.h"
+#include "graph.h"
+
+#ifndef CM_SYMMETRY_H
+#define CM_SYMMETRY_H
+
+class SymmetryClasses {
+ public:
+  /* Candidates tried per bucket before giving up on finding a class for an
+     element (it is then left on its own, which is always sound) */
+  static const size_t MAX_REPRESENTATIVES = 32;
+
+  size_t num_classes() const { return members_.size(); }
+  size_t class_of(size_t v) const { return class_[v]; }
+  const std::vector<size_t>& members(size_t c) const { return members_[c]; }
+
+  /* Compute the classes of the structure with propositions props, where
+     (prop, pos) \in inv_label[v] iff props.vars(prop)[pos] = v, given a
+     partition of its elements that no two interchangeable elements straddle
+     (e.g. elements of equal signature) */
+  void build(const PropTable& props, const std::vector<std::vector<Graph::Edge>>& inv_label,
+             const std::vector<std::vector<size_t>>& partition) {
+    class_.assign(inv_label.size(), 0);
+    members_.clear();
+    std::vector<size_t> part(inv_label.size(), 0);
+    for (size_t c = 0; c < partition.size(); ++c) {
+      for (size_t i = 0; i < partition[c].size(); ++i) part[partition[c][i]] = c;
+    }
+    TupleSet tuples;
+    tuples.build(props);
+
+    std::vector<size_t> reps;
+    for (size_t c = 0; c < partition.size(); ++c) {
+      if (partition[c].size() == 1) {
+        add_class(partition[c][0]);
+        continue;
+      }
+      /* refine by the parts of the elements each element occurs with */
+      std::map<std::vector<size_t>, std::vector<size_t>> buckets;
+      for (size_t i = 0; i < partition[c].size(); ++i) {
+        size_t v = partition[c][i];
+        std::vector<std::vector<size_t>> occurrences;
+        for (size_t j = 0; j < inv_label[v].size(); ++j) {
+          size_t p = inv_label[v][j].vertex;
+          std::vector<size_t> key(1, props.pred(p));
+          key.push_back(inv_label[v][j].position);
+          for (size_t k = 0; k < props.arity(p); ++k) key.push_back(part[props.vars(p)[k]]);
+          occurrences.push_back(key);
+        }
+        std::sort(occurrences.begin(), occurrences.end());
+        std::vector<size_t> key;
+        for (size_t j = 0; j < occurrences.size(); ++j) {
+          key.insert(key.end(), occurrences[j].begin(), occurrences[j].end());
+        }
+        buckets[key].push_back(v);
+      }
+      /* then test transpositions against a representative of each class so far */
+      for (std::map<std::vector<size_t>, std::vector<size_t>>::iterator it = buckets.begin(); it != buckets.end(); ++it) {
+        reps.clear();
+        for (size_t i = 0; i < it->second.size(); ++i) {
+          size_t v = it->second[i];
+          size_t r;
+          for (r = 0; r < reps.size() && !swappable(props, inv_label, tuples, v, reps[r]); ++r);
+          if (r < reps.size()) {
+            class_[v] = class_[reps[r]];
+            members_[class_[v]].push_back(v);
+          } else {
+            add_class(v);
+            if (reps.size() < MAX_REPRESENTATIVES) reps.push_back(v);
+          }
+        }
+      }
+    }
+  }
+
+ private:
+  std::vector<size_t> class_;
+  std::vector<std::vector<size_t>> members_;
+
+  void add_class(size_t v) {
+    class_[v] = members_.size();
+    members_.push_back(std::vector<size_t>(1, v));
+  }
+
+  /* Does swapping v and w map each proposition mentioning either to a proposition? */
+  static bool swappable(const PropTable& props, const std::vector<std::vector<Graph::Edge>>& inv_label,
+                        const TupleSet& tuples, size_t v, size_t w) {
+    if (inv_label[v].size() != inv_label[w].size()) return false;
+    std::vector<size_t> swapped;
+    for (size_t side = 0; side < 2; ++side) {
+      const std::vector<Graph::Edge>& occ = inv_label[side == 0 ? v : w];
+      for (size_t j = 0; j < occ.size(); ++j) {
+        size_t p = occ[j].vertex;
+        const size_t* vars = props.vars(p);
+        swapped.assign(vars, vars + props.arity(p));
+        for (size_t k = 0; k < swapped.size(); ++k) {
+          if (swapped[k] == v) swapped[k] = w;
+          else if (swapped[k] == w) swapped[k] = v;
+        }
+        if (tuples.find(props, props.pred(p), swapped.data(), swapped.size()) == TupleSet::npos) return false;
+      }
+    }
+    return true;
+  }
+};
+
+#endif
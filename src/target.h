@@ -0,0 +1,378 @@
+/*****************************************************************************
+  Author: Charlie Murphy
+  Email:  tcm3@cs.princeton.edu
+
+  Date:   October 18, 2026
+
+  Description: Preprocessed target structure. Everything the embedding
+    needs to know about the structure B being embedded into, computed once
+    and shared (read only) by any number of embeddings into B. When B
+    changes, its owner updates the target while none of the embeddings
+    sharing it run (see update).
+ *****************************************************************************/
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <mutex>
+#include <functional>
+#include <cassert>
+#include "structure.h"
+#include "definitions.h"
+#include "graph.h"
+#include "stats.h"
+#include "symmetry.h"
+#include "locality.h"
+
+#ifndef CM_TARGET_H
+#define CM_TARGET_H
+
+template <class Element, class Predicate, class Signature>
+class Target {
+  public:
+    typedef Structure<Element, Predicate, Signature> Str;
+
+    /* b must outlive the target; with reorder the target works on a copy of b
+       renumbered for locality (see locality.h), whose ids original_id and
+       local_id convert to and from those of b */
+    explicit Target(const Str& b, bool reorder = false) : b_(&b, [](const Str*) {}) {
+      if (reorder) renumber();
+      build();
+    }
+
+    explicit Target(std::shared_ptr<const Str> b, bool reorder = false) : b_(b) {
+      if (reorder) renumber();
+      build();
+    }
+
+    const Str& structure() const { return *b_; }
+    std::shared_ptr<const Str> shared_structure() const { return b_; }
+    const PropTable& props() const { return b_->propositions(); }
+    size_t universe_size() const { return b_->universe_size(); }
+
+    /* The element of the b given for element v of structure(), and back
+       (the identity unless reordered) */
+    bool reordered() const { return !order_.empty(); }
+    size_t original_id(size_t v) const { return order_.empty() ? v : order_[v]; }
+    size_t local_id(size_t v) const { return rank_.empty() ? v : rank_[v]; }
+
+    /* Elements of b partitioned into classes of equal signatures */
+    size_t num_classes() const { return classes_.size(); }
+    const Signature& class_signature(size_t c) const { return b_->get_signature(classes_[c][0]); }
+    const std::vector<size_t>& class_members(size_t c) const { return classes_[c]; }
+
+    /* Elements of b that an element with signature s can map to (their
+       signatures are above s, or with homomorphism s occurs within them), in
+       increasing order; tested once per class */
+    std::vector<size_t> candidates(const Signature& s, bool homomorphism) const {
+      std::vector<size_t> vs;
+      for (size_t c = 0; c < classes_.size(); ++c) {
+        const Signature& t = class_signature(c);
+        if (homomorphism ? s.occurs_within(t) : s <= t) vs.insert(vs.end(), classes_[c].begin(), classes_[c].end());
+      }
+      std::sort(vs.begin(), vs.end());
+      return vs;
+    }
+
+    /* Propositions of b with relation symbol q, in increasing order */
+    const std::vector<size_t>& pred_props(size_t q) const {
+      static const std::vector<size_t> none;
+      return q < pred_props_.size() ? pred_props_[q] : none;
+    }
+
+    /* Number of argument positions holding each element, largest first */
+    const std::vector<size_t>& degree_sequence() const { return degrees_; }
+
+    /* (vert, pos) \in inv_label(v) -> props().vars(vert)[pos] = v, ordered by
+       the relation symbol of vert, then pos, then vert */
+    const std::vector<Graph::Edge>& inv_label(size_t v) const { return inv_label_[v]; }
+
+    /* The propositions q(..., v, ...) with v at position pos, as a range of inv_label(v) */
+    std::pair<const Graph::Edge*, const Graph::Edge*> occurrences(size_t v, size_t q, size_t pos) const {
+      const PropTable& props = b_->propositions();
+      const Graph::Edge* first = inv_label_[v].data();
+      const Graph::Edge* last = first + inv_label_[v].size();
+      first = std::lower_bound(first, last, std::make_pair(q, pos), [&props](const Graph::Edge& e, const std::pair<size_t, size_t>& key) {
+        return std::make_pair(props.pred(e.vertex), e.position) < key;
+      });
+      last = std::upper_bound(first, last, std::make_pair(q, pos), [&props](const std::pair<size_t, size_t>& key, const Graph::Edge& e) {
+        return key < std::make_pair(props.pred(e.vertex), e.position);
+      });
+      return std::make_pair(first, last);
+    }
+
+    /* Heap bytes held by b and the indexes over it */
+    size_t memory_bytes() const {
+      return b_->memory_bytes() + heap_bytes(classes_) + heap_bytes(pred_props_) + heap_bytes(inv_label_)
+             + heap_bytes(degrees_) + tuples_.memory_bytes() + heap_bytes(order_) + heap_bytes(rank_)
+             + heap_bytes(class_of_) + heap_bytes(class_bucket_);
+    }
+
+    /* Membership index over props() */
+    const TupleSet& tuples() const { return tuples_; }
+
+    /* The number of the last change set of b reflected here (see update) */
+    size_t changes_reflected() const { return serial_; }
+
+    /* Classes of interchangeable elements of b, computed on first use (and
+       again after an update) */
+    const SymmetryClasses& symmetries() const {
+      std::lock_guard<std::mutex> lock(symmetries_lock_);
+      if (!symmetries_built_) {
+        symmetries_ = SymmetryClasses();
+        symmetries_.build(b_->propositions(), inv_label_, classes_);
+        symmetries_built_ = true;
+      }
+      return symmetries_;
+    }
+
+    /* Bring the indexes up to date after b changed by c (as returned by
+       take_changes on b; not for a reordered target, whose ids differ from
+       those of c). This changes what the embeddings sharing the target read,
+       so none of them may be running; call their update_target after it.
+       A change set already reflected is skipped. The elements whose
+       signature changed move between classes and the new propositions are
+       indexed, in time proportional to them, except that removed
+       propositions renumber the later ones everywhere. A change set that was missed, or that was
+       partly made before the target was built, rebuilds everything. The
+       symmetry classes are not patched: the next call to symmetries()
+       rebuilds them over all of b. */
+    void update(const StructureChanges& c) {
+      assert(order_.empty());
+      if (c.serial <= serial_) return;
+      if (c.serial == serial_ + 1 && c.serial != partial_) {
+        patch(c);
+        serial_ = c.serial;
+        partial_ = b_->has_changes() ? serial_ + 1 : 0;
+      } else {
+        classes_.clear();
+        pred_props_.clear();
+        inv_label_.clear();
+        degrees_.clear();
+        buckets_.clear();
+        build();
+      }
+      symmetries_built_ = false;
+    }
+
+  private:
+    std::shared_ptr<const Str> b_;
+    std::vector<std::vector<size_t>> classes_;
+    std::vector<std::vector<size_t>> pred_props_;
+    std::vector<std::vector<Graph::Edge>> inv_label_;
+    std::vector<size_t> degrees_;
+    TupleSet tuples_;
+    mutable std::mutex symmetries_lock_;
+    mutable bool symmetries_built_;
+    mutable SymmetryClasses symmetries_;
+    /* classes of each bucket of elements occurring at the same (predicate,
+       position) pairs equally often, and the class and bucket of each */
+    typedef std::map<std::vector<std::pair<size_t, size_t>>, std::vector<size_t>> Buckets;
+    Buckets buckets_;
+    std::vector<size_t> class_of_;
+    std::vector<typename Buckets::iterator> class_bucket_;
+    size_t serial_;    /* last change set of b reflected here */
+    size_t partial_;   /* change set of b partly reflected (made before building), 0 if none */
+    std::vector<size_t> order_;   /* original id of each element, empty unless reordered */
+    std::vector<size_t> rank_;    /* inverse of order_ */
+
+    /* Replace b by a copy renumbered for locality */
+    void renumber() {
+      CM_TIME_PHASE(PHASE_SIGNATURES);
+      std::vector<size_t> prop_order;
+      order_ = locality_order(b_->propositions(), b_->universe_size());
+      b_ = std::make_shared<const Str>(renumbered(*b_, order_, prop_order));
+      rank_.resize(order_.size());
+      for (size_t v = 0; v < order_.size(); ++v) rank_[order_[v]] = v;
+    }
+
+    void build() {
+      CM_TIME_PHASE(PHASE_SIGNATURES);
+      const PropTable& props = b_->propositions();
+      inv_label_.resize(b_->universe_size());
+      for (size_t i = 0; i < props.size(); ++i) {
+        if (pred_props_.size() <= props.pred(i)) {
+          pred_props_.resize(props.pred(i) + 1);
+        }
+        pred_props_[props.pred(i)].push_back(i);
+        const size_t* vars = props.vars(i);
+        for (size_t k = 0; k < props.arity(i); ++k) {
+          inv_label_[vars[k]].emplace_back(i, k);
+        }
+      }
+      for (size_t v = 0; v < inv_label_.size(); ++v) {
+        /* propositions were added in increasing order, so a stable sort keeps them ordered within a (symbol, position) run */
+        std::stable_sort(inv_label_[v].begin(), inv_label_[v].end(), [&props](const Graph::Edge& x, const Graph::Edge& y) {
+          return std::make_pair(props.pred(x.vertex), x.position) < std::make_pair(props.pred(y.vertex), y.position);
+        });
+        degrees_.push_back(inv_label_[v].size());
+      }
+      std::sort(degrees_.begin(), degrees_.end(), std::greater<size_t>());
+      tuples_.build(props);
+      fill_classes();
+      symmetries_built_ = false;
+      serial_ = b_->changes_taken();
+      partial_ = b_->has_changes() ? serial_ + 1 : 0;
+    }
+
+    /* Apply the change set c that follows the last one reflected (see update) */
+    void patch(const StructureChanges& c) {
+      const PropTable& props = b_->propositions();
+      /* elements whose occurrences changed, and their degrees before */
+      std::vector<size_t> changed(c.touched);
+      for (size_t v = c.universe_size; v < b_->universe_size(); ++v) changed.push_back(v);
+      std::sort(changed.begin(), changed.end());
+      changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+      std::vector<size_t> before(changed.size(), 0);
+      for (size_t i = 0; i < changed.size() && changed[i] < c.universe_size; ++i) before[i] = inv_label_[changed[i]].size();
+      inv_label_.resize(b_->universe_size());
+
+      /* new propositions come after the remaining old ones, which keep their order */
+      std::vector<size_t> added;
+      if (c.renumber.empty()) {
+        for (size_t q = c.size; q < props.size(); ++q) added.push_back(q);
+      } else {
+        for (size_t r = 0; r < pred_props_.size(); ++r) renumber_ids(pred_props_[r], c.renumber);
+        for (size_t v = 0; v < c.universe_size; ++v) renumber_edges(inv_label_[v], c.renumber);
+        std::vector<char> old(props.size(), 0);
+        for (size_t i = 0; i < c.renumber.size(); ++i) {
+          if (c.renumber[i] != TupleSet::npos) old[c.renumber[i]] = 1;
+        }
+        for (size_t q = 0; q < old.size(); ++q) {
+          if (!old[q]) added.push_back(q);
+        }
+      }
+      for (size_t i = 0; i < added.size(); ++i) {
+        size_t q = added[i];
+        if (pred_props_.size() <= props.pred(q)) pred_props_.resize(props.pred(q) + 1);
+        pred_props_[props.pred(q)].push_back(q);
+        const size_t* vars = props.vars(q);
+        for (size_t k = 0; k < props.arity(q); ++k) {
+          std::vector<Graph::Edge>& label = inv_label_[vars[k]];
+          std::pair<size_t, size_t> key(props.pred(q), k);
+          label.insert(std::upper_bound(label.begin(), label.end(), key, [&props](const std::pair<size_t, size_t>& x, const Graph::Edge& e) {
+            return x < std::make_pair(props.pred(e.vertex), e.position);
+          }), Graph::Edge(q, k));
+        }
+        if (c.renumber.empty()) tuples_.insert(props, q);
+      }
+      if (!c.renumber.empty()) tuples_.build(props);
+
+      for (size_t i = 0; i < changed.size(); ++i) {
+        size_t v = changed[i];
+        if (v < c.universe_size) {
+          degrees_.erase(std::lower_bound(degrees_.begin(), degrees_.end(), before[i], std::greater<size_t>()));
+          leave_class(v);
+        }
+        degrees_.insert(std::lower_bound(degrees_.begin(), degrees_.end(), inv_label_[v].size(), std::greater<size_t>()),
+                        inv_label_[v].size());
+      }
+      /* only once every changed element left its class, so that representatives are unchanged */
+      class_of_.resize(b_->universe_size());
+      for (size_t i = 0; i < changed.size(); ++i) join_class(changed[i]);
+    }
+
+    static void renumber_ids(std::vector<size_t>& ids, const std::vector<size_t>& renumber) {
+      size_t n = 0;
+      for (size_t i = 0; i < ids.size(); ++i) {
+        if (renumber[ids[i]] != TupleSet::npos) ids[n++] = renumber[ids[i]];
+      }
+      ids.resize(n);
+    }
+
+    static void renumber_edges(std::vector<Graph::Edge>& edges, const std::vector<size_t>& renumber) {
+      size_t n = 0;
+      for (size_t i = 0; i < edges.size(); ++i) {
+        if (renumber[edges[i].vertex] != TupleSet::npos) edges[n++] = Graph::Edge(renumber[edges[i].vertex], edges[i].position);
+      }
+      edges.resize(n);
+    }
+
+    /* The (predicate, position) pairs v occurs at, in order and repeated */
+    std::vector<std::pair<size_t, size_t>> occurrence_key(size_t v) const {
+      const PropTable& props = b_->propositions();
+      std::vector<std::pair<size_t, size_t>> key;
+      for (size_t i = 0; i < inv_label_[v].size(); ++i) {
+        key.emplace_back(props.pred(inv_label_[v][i].vertex), inv_label_[v][i].position);
+      }
+      return key;
+    }
+
+    /* Put v in the class of its bucket with an equal signature, or a new one */
+    void join_class(size_t v) {
+      typename Buckets::iterator bucket = buckets_.insert(std::make_pair(occurrence_key(v), std::vector<size_t>())).first;
+      const Signature& sig = b_->get_signature(v);
+      for (size_t i = 0; i < bucket->second.size(); ++i) {
+        size_t c = bucket->second[i];
+        const Signature& rep = b_->get_signature(classes_[c][0]);
+        if (sig <= rep && rep <= sig) {
+          classes_[c].insert(std::lower_bound(classes_[c].begin(), classes_[c].end(), v), v);
+          class_of_[v] = c;
+          return;
+        }
+      }
+      class_of_[v] = classes_.size();
+      bucket->second.push_back(classes_.size());
+      classes_.push_back(std::vector<size_t>(1, v));
+      class_bucket_.push_back(bucket);
+    }
+
+    /* Take v out of its class, dropping the class (and its bucket) if empty;
+       the last class takes the place of a dropped one */
+    void leave_class(size_t v) {
+      size_t c = class_of_[v];
+      std::vector<size_t>& members = classes_[c];
+      members.erase(std::lower_bound(members.begin(), members.end(), v));
+      if (!members.empty()) return;
+      std::vector<size_t>& bucket = class_bucket_[c]->second;
+      bucket.erase(std::find(bucket.begin(), bucket.end(), c));
+      if (bucket.empty()) buckets_.erase(class_bucket_[c]);
+      size_t last = classes_.size() - 1;
+      if (c != last) {
+        classes_[c].swap(classes_[last]);
+        class_bucket_[c] = class_bucket_[last];
+        std::vector<size_t>& moved = class_bucket_[c]->second;
+        *std::find(moved.begin(), moved.end(), last) = c;
+        for (size_t i = 0; i < classes_[c].size(); ++i) class_of_[classes_[c][i]] = c;
+      }
+      classes_.pop_back();
+      class_bucket_.pop_back();
+    }
+
+    /* Elements occurring at the same (predicate, position) pairs equally often
+       are bucketed together (see occurrence_key); a bucket is then split by
+       signature equality, so the classes are correct for any signature whose
+       <= is a preorder. */
+    void fill_classes() {
+      std::map<std::vector<std::pair<size_t, size_t>>, std::vector<size_t>> buckets;
+      for (size_t v = 0; v < inv_label_.size(); ++v) {
+        buckets[occurrence_key(v)].push_back(v);
+      }
+      class_of_.resize(inv_label_.size());
+      class_bucket_.clear();
+      for (auto it = buckets.begin(); it != buckets.end(); ++it) {
+        typename Buckets::iterator bucket = buckets_.insert(std::make_pair(it->first, std::vector<size_t>())).first;
+        size_t first = classes_.size();
+        for (size_t i = 0; i < it->second.size(); ++i) {
+          size_t v = it->second[i];
+          const Signature& sig = b_->get_signature(v);
+          size_t c;
+          for (c = first; c < classes_.size(); ++c) {
+            const Signature& rep = b_->get_signature(classes_[c][0]);
+            if (sig <= rep && rep <= sig) break;
+          }
+          if (c == classes_.size()) {
+            classes_.push_back(std::vector<size_t>());
+            class_bucket_.push_back(bucket);
+            bucket->second.push_back(c);
+          }
+          classes_[c].push_back(v);
+          class_of_[v] = c;
+        }
+      }
+    }
+};
+
+#endif
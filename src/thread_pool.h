@@ -0,0 +1,127 @@
+/*******************************************************************
+    Author: Charlie Murphy
+    Email:  tcm3@cs.princeton.edu
+
+    Date:   October 18, 2026
+
+    Description: A fixed size thread pool and a memory budget used to
+    bound how much work is in flight at once
+ *******************************************************************/
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#ifndef CM_THREAD_POOL_H
+#define CM_THREAD_POOL_H
+
+/* Runs submitted tasks on n worker threads in submission order */
+class ThreadPool {
+ public:
+  explicit ThreadPool(size_t n) : pending_(0), stop_(false) {
+    if (n == 0) n = 1;
+    for (size_t i = 0; i < n; ++i) {
+      workers_.push_back(std::thread(&ThreadPool::run, this));
+    }
+  }
+
+  ~ThreadPool() {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    work_.notify_all();
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      workers_[i].join();
+    }
+  }
+
+  size_t size() const { return workers_.size(); }
+
+  void submit(const std::function<void()>& task) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      tasks_.push(task);
+      ++pending_;
+    }
+    work_.notify_one();
+  }
+
+  /* Block until every submitted task has finished */
+  void wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (pending_ != 0) done_.wait(lock);
+  }
+
+ private:
+  std::vector<std::thread> workers_;
+  std::queue<std::function<void()>> tasks_;
+  size_t pending_;   /* submitted but not finished */
+  bool stop_;
+  std::mutex mutex_;
+  std::condition_variable work_;
+  std::condition_variable done_;
+
+  void run() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_ && tasks_.empty()) work_.wait(lock);
+        if (tasks_.empty()) return;
+        task = tasks_.front();
+        tasks_.pop();
+      }
+      task();
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (--pending_ == 0) done_.notify_all();
+      }
+    }
+  }
+
+  ThreadPool(const ThreadPool&);
+  ThreadPool& operator = (const ThreadPool&);
+};
+
+/* A pool of bytes handed out first come first served. A request larger than
+   the whole budget is clamped to it, so it runs once everything else has
+   been released. A budget of 0 is unlimited. */
+class MemoryBudget {
+ public:
+  explicit MemoryBudget(size_t bytes = 0) : total_(bytes), used_(0), next_(0), serving_(0) {}
+
+  /* Wait until bytes are available and take them; returns the amount taken */
+  size_t acquire(size_t bytes) {
+    if (total_ == 0) return 0;
+    if (bytes > total_) bytes = total_;
+    std::unique_lock<std::mutex> lock(mutex_);
+    size_t ticket = next_++;
+    while (ticket != serving_ || used_ + bytes > total_) released_.wait(lock);
+    used_ += bytes;
+    ++serving_;
+    released_.notify_all();
+    return bytes;
+  }
+
+  void release(size_t bytes) {
+    if (total_ == 0) return;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      used_ -= bytes;
+    }
+    released_.notify_all();
+  }
+
+ private:
+  size_t total_;
+  size_t used_;
+  size_t next_;      /* next ticket to hand out */
+  size_t serving_;   /* ticket allowed to take memory next */
+  std::mutex mutex_;
+  std::condition_variable released_;
+};
+
+#endif
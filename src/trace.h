@@ -0,0 +1,239 @@
+/*****************************************************************************
+  Author: Charlie Murphy
+  Email:  tcm3@cs.princeton.edu
+
+  Date:   October 18, 2026
+
+  Description: Search tree traces. A TraceSink records every decision
+    (with the number of universe and predicate edges it removed, and
+    optionally the edges themselves), every backtrack with its reason, the
+    edges blamed by symmetry along with a backtracked decision, and a
+    timestamp for each, so that long searches can be analysed offline
+    (see trace_summary.cc).
+
+    Binary traces are a header of two 64 bit words (TRACE_MAGIC and
+    TRACE_VERSION) followed by TraceRecords in native byte order. Chrome
+    traces use the trace event format: a decision opens a slice that the
+    backtrack over it closes, so the flame chart is the search tree.
+ *****************************************************************************/
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "definitions.h"
+#include "graph.h"
+
+#ifndef CM_TRACE_H
+#define CM_TRACE_H
+
+static const uint64_t TRACE_MAGIC = 0x3145434152544d45ULL; /* "EMTRACE1" */
+static const uint64_t TRACE_VERSION = 2;
+
+/* Kinds of trace records */
+enum Trace_event {
+  TRACE_DECISION = 0,  // u |-> v was decided
+  TRACE_BACKTRACK,     // the decision u |-> v was undone and blamed
+  TRACE_REMOVED_U,     // universe edge (u, v) removed by the last decision
+  TRACE_REMOVED_P,     // predicate edge (u, v) removed by the last decision
+  TRACE_END,           // the search finished (reason holds the Search_result)
+  TRACE_BLAMED,        // universe edge (u, v) blamed by symmetry with the last backtrack
+};
+
+/* Why the search backtracked */
+enum Backtrack_reason {
+  MATCHING_DEFICIT = 0,  // no total matching of the universe graph
+  FILTER_WIPEOUT,        // filtering after the decision emptied a domain
+  INVALID_DECISION,      // no conflicting element had a choice left
+};
+
+struct TraceRecord {
+  uint64_t time_ns;     /* since the sink was opened */
+  uint32_t depth;       /* decisions on the stack after the event */
+  uint8_t type;         /* Trace_event */
+  uint8_t reason;       /* Backtrack_reason of a backtrack */
+  uint16_t unused;
+  uint32_t u;
+  uint32_t v;
+  uint32_t removed_u;   /* universe edges removed by a decision */
+  uint32_t removed_p;   /* predicate edges removed by a decision */
+};
+
+class TraceSink {
+ public:
+  enum Format { BINARY, CHROME };
+
+  /* With edges set the removed edges of every decision are recorded too */
+  TraceSink(const std::string& file_name, Format format = BINARY, bool edges = false) :
+    out_(fopen(file_name.c_str(), "wb")), format_(format), edges_(edges), depth_(0), first_(true),
+    start_(std::chrono::steady_clock::now()), elements_(NULL), props_(NULL) {
+    if (out_ == NULL) return;
+    if (format_ == BINARY) {
+      uint64_t header[2] = {TRACE_MAGIC, TRACE_VERSION};
+      fwrite(header, sizeof(header), 1, out_);
+    } else {
+      fputs("{\"traceEvents\": [\n", out_);
+    }
+  }
+
+  ~TraceSink() {
+    if (out_ == NULL) return;
+    flush();
+    if (format_ == CHROME) {
+      fputs("\n]}\n", out_);
+    }
+    fclose(out_);
+  }
+
+  bool is_open() const { return out_ != NULL; }
+
+  /* Record a search on part of the pattern (e.g. one of its components) in
+     the ids of the whole: its element u as elements[u] and its proposition
+     p as props[p]. NULL for both records ids as they are. */
+  void translate(const std::vector<size_t>* elements, const std::vector<size_t>* props) {
+    elements_ = elements;
+    props_ = props;
+  }
+
+  /* d has just been decided; depth counts it */
+  void record_decision(const decision& d, size_t depth) {
+    if (out_ == NULL) return;
+    depth_ = depth;
+    TraceRecord r = make_record(TRACE_DECISION, element(d.u), d.v);
+    r.removed_u = d.remove_u.size();
+    r.removed_p = d.remove_p.size();
+    if (format_ == BINARY) {
+      push(r);
+      if (edges_) {
+        for (size_t i = 0; i < d.remove_u.size(); ++i) push(make_record(TRACE_REMOVED_U, element(d.remove_u[i].u), d.remove_u[i].v));
+        for (size_t i = 0; i < d.remove_p.size(); ++i) push(make_record(TRACE_REMOVED_P, prop(d.remove_p[i].u), d.remove_p[i].v));
+      }
+      return;
+    }
+    event("B", r);
+    fprintf(out_, ", \"name\": \"%u -> %u\", \"args\": {\"depth\": %u, \"removed_u\": %u, \"removed_p\": %u",
+            r.u, r.v, r.depth, r.removed_u, r.removed_p);
+    if (edges_) {
+      edge_list("universe", d.remove_u, elements_);
+      edge_list("predicate", d.remove_p, props_);
+    }
+    fputs("}}", out_);
+  }
+
+  /* The decision d (on top of a stack of depth decisions) is about to be undone */
+  void record_backtrack(const decision& d, size_t depth, Backtrack_reason reason) {
+    if (out_ == NULL) return;
+    depth_ = depth - 1;
+    TraceRecord r = make_record(TRACE_BACKTRACK, element(d.u), d.v);
+    r.reason = reason;
+    if (format_ == BINARY) {
+      push(r);
+      return;
+    }
+    static const char* reasons[] = {"matching_deficit", "filter_wipeout", "invalid_decision"};
+    event("E", r);
+    fprintf(out_, ", \"args\": {\"reason\": \"%s\"}}", reasons[reason]);
+  }
+
+  /* The edges blamed[first..] were blamed by symmetry with the decision just backtracked */
+  void record_blamed(const std::vector<Graph::VertexPair>& blamed, size_t first) {
+    if (out_ == NULL || first >= blamed.size()) return;
+    if (format_ == BINARY) {
+      for (size_t i = first; i < blamed.size(); ++i) push(make_record(TRACE_BLAMED, element(blamed[i].u), blamed[i].v));
+      return;
+    }
+    std::vector<Graph::VertexPair> edges(blamed.begin() + first, blamed.end());
+    event("i", make_record(TRACE_BLAMED, 0, 0));
+    fprintf(out_, ", \"s\": \"t\", \"name\": \"blamed by symmetry\", \"args\": {\"blamed\": %lu", edges.size());
+    edge_list("universe", edges, elements_);
+    fputs("}}", out_);
+  }
+
+  /* The search ended with result (a Search_result) */
+  void record_end(int result) {
+    if (out_ == NULL) return;
+    TraceRecord r = make_record(TRACE_END, 0, 0);
+    r.reason = result;
+    if (format_ == BINARY) {
+      push(r);
+      return;
+    }
+    close_slices(r);
+  }
+
+  /* The search of one part of the pattern (see translate) ended; the
+     decisions it left on the stack are not backtracked, so their slices
+     are closed here for the next part to start at the bottom */
+  void end_component() {
+    if (out_ == NULL) return;
+    if (format_ == CHROME) close_slices(make_record(TRACE_END, 0, 0));
+    depth_ = 0;
+  }
+
+ private:
+  FILE* out_;
+  Format format_;
+  bool edges_;
+  size_t depth_;
+  bool first_;   /* no chrome event written yet */
+  std::chrono::steady_clock::time_point start_;
+  std::vector<TraceRecord> buffer_;
+  const std::vector<size_t>* elements_;  /* see translate */
+  const std::vector<size_t>* props_;
+
+  size_t element(size_t u) const { return elements_ == NULL ? u : (*elements_)[u]; }
+  size_t prop(size_t p) const { return props_ == NULL ? p : (*props_)[p]; }
+
+  TraceRecord make_record(Trace_event type, size_t u, size_t v) const {
+    TraceRecord r;
+    r.time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count();
+    r.depth = depth_;
+    r.type = type;
+    r.reason = 0;
+    r.unused = 0;
+    r.u = u;
+    r.v = v;
+    r.removed_u = 0;
+    r.removed_p = 0;
+    return r;
+  }
+
+  void push(const TraceRecord& r) {
+    buffer_.push_back(r);
+    if (buffer_.size() >= 4096) flush();
+  }
+
+  void flush() {
+    if (!buffer_.empty()) fwrite(buffer_.data(), sizeof(TraceRecord), buffer_.size(), out_);
+    buffer_.clear();
+  }
+
+  /* Close the chrome slices of the decisions still on the stack at r */
+  void close_slices(const TraceRecord& r) {
+    for (; depth_ > 0; --depth_) {
+      event("E", r);
+      fputs("}", out_);
+    }
+  }
+
+  /* Start a chrome event of phase ph (left open for further fields) */
+  void event(const char* ph, const TraceRecord& r) {
+    fprintf(out_, "%s{\"ph\": \"%s\", \"pid\": 1, \"tid\": 1, \"ts\": %.3f", first_ ? "" : ",\n", ph, r.time_ns / 1000.0);
+    first_ = false;
+  }
+
+  /* The edges, their first ends translated by ids (if not NULL) */
+  void edge_list(const char* name, const std::vector<Graph::VertexPair>& edges, const std::vector<size_t>* ids) {
+    fprintf(out_, ", \"%s\": [", name);
+    for (size_t i = 0; i < edges.size(); ++i) {
+      fprintf(out_, "%s[%lu, %lu]", i == 0 ? "" : ", ", ids == NULL ? edges[i].u : (*ids)[edges[i].u], edges[i].v);
+    }
+    fputs("]", out_);
+  }
+
+  TraceSink(const TraceSink&);
+  TraceSink& operator = (const TraceSink&);
+};
+
+#endif
@@ -0,0 +1,163 @@
+/*******************************************************************
+    Author: Charlie Murphy
+    Email:  tcm3@cs.princeton.edu
+
+    Date:   October 18, 2026
+
+    Description: Summarizes a binary search tree trace written by
+    TraceSink: backtracks by reason, the number of decisions and
+    backtracks at each depth, the largest subtrees and the elements
+    (and decisions) blamed most often, by backtracks or by symmetry
+    with them.
+ *******************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include "trace.h"
+
+using namespace std;
+
+/* A decision whose subtree has been closed */
+struct Subtree {
+  size_t depth;
+  size_t u;
+  size_t v;
+  size_t decisions;   /* decisions below it, including itself */
+  double ms;
+};
+
+/* The k largest counts of m, largest first */
+template <class Key>
+vector<pair<size_t, Key>> top(const map<Key, size_t>& m, size_t k) {
+  vector<pair<size_t, Key>> v;
+  for (typename map<Key, size_t>::const_iterator it = m.begin(); it != m.end(); ++it) {
+    v.push_back(make_pair(it->second, it->first));
+  }
+  sort(v.begin(), v.end(), [](const pair<size_t, Key>& x, const pair<size_t, Key>& y) { return x.first > y.first; });
+  if (v.size() > k) v.resize(k);
+  return v;
+}
+
+int main(int argc, char ** argv) {
+  size_t k = 10;
+  string file_name;
+  for (int i = 1; i < argc; ++i) {
+    string arg(argv[i]);
+    if (arg == "--top" && i + 1 < argc) {
+      k = strtoul(argv[++i], NULL, 10);
+    } else {
+      file_name = arg;
+    }
+  }
+  if (file_name.empty()) {
+    cerr << "usage: trace-summary [--top k] trace" << endl;
+    return 1;
+  }
+
+  ifstream ins(file_name, ios::binary);
+  uint64_t header[2];
+  if (!ins.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != TRACE_MAGIC || header[1] != TRACE_VERSION) {
+    cerr << file_name << " is not a binary trace" << endl;
+    return 1;
+  }
+
+  static const char* reasons[] = {"matching deficit", "filter wipeout", "invalid decision"};
+  static const char* results[] = {"unsatisfiable", "satisfiable", "unknown"};
+  size_t decisions = 0, backtracks = 0, by_reason[3] = {0, 0, 0}, by_symmetry = 0;
+  vector<size_t> depth_decisions, depth_backtracks;
+  vector<Subtree> open, closed;
+  map<size_t, size_t> blamed;
+  map<pair<size_t, size_t>, size_t> blamed_pairs;
+  uint64_t end_ns = 0;
+  int result = -1;
+
+  TraceRecord r;
+  while (ins.read(reinterpret_cast<char*>(&r), sizeof(r))) {
+    end_ns = r.time_ns;
+    if (r.type == TRACE_DECISION) {
+      ++decisions;
+      if (depth_decisions.size() <= r.depth) depth_decisions.resize(r.depth + 1, 0);
+      ++depth_decisions[r.depth];
+      Subtree s = {r.depth, r.u, r.v, decisions, r.time_ns / 1e6};
+      open.push_back(s);
+    } else if (r.type == TRACE_BACKTRACK) {
+      ++backtracks;
+      if (r.reason < 3) ++by_reason[r.reason];
+      if (depth_backtracks.size() <= r.depth + 1) depth_backtracks.resize(r.depth + 2, 0);
+      ++depth_backtracks[r.depth + 1];
+      ++blamed[r.u];
+      ++blamed_pairs[make_pair((size_t) r.u, (size_t) r.v)];
+      if (!open.empty()) {
+        Subtree s = open.back();
+        open.pop_back();
+        s.decisions = decisions - s.decisions + 1;
+        s.ms = r.time_ns / 1e6 - s.ms;
+        closed.push_back(s);
+      }
+    } else if (r.type == TRACE_BLAMED) {
+      ++by_symmetry;
+      ++blamed[r.u];
+      ++blamed_pairs[make_pair((size_t) r.u, (size_t) r.v)];
+    } else if (r.type == TRACE_END) {
+      result = r.reason;
+    }
+  }
+  /* decisions still open at the end of the search span the rest of it */
+  while (!open.empty()) {
+    Subtree s = open.back();
+    open.pop_back();
+    s.decisions = decisions - s.decisions + 1;
+    s.ms = end_ns / 1e6 - s.ms;
+    closed.push_back(s);
+  }
+
+  printf("result: %s\n", result >= 0 && result < 3 ? results[result] : "not recorded");
+  printf("time: %.3f ms\n", end_ns / 1e6);
+  printf("decisions: %lu\n", decisions);
+  printf("backtracks: %lu", backtracks);
+  for (size_t i = 0; i < 3; ++i) printf("%s%s %lu", i == 0 ? " (" : ", ", reasons[i], by_reason[i]);
+  printf(")\n");
+  printf("blamed by symmetry: %lu\n", by_symmetry);
+
+  size_t max_depth = max(depth_decisions.size(), depth_backtracks.size());
+  depth_decisions.resize(max_depth, 0);
+  depth_backtracks.resize(max_depth, 0);
+  vector<size_t> subtree_total(max_depth, 0), subtree_count(max_depth, 0);
+  for (size_t i = 0; i < closed.size(); ++i) {
+    subtree_total[closed[i].depth] += closed[i].decisions;
+    ++subtree_count[closed[i].depth];
+  }
+  printf("\n%6s %12s %12s %14s\n", "depth", "decisions", "backtracks", "mean subtree");
+  for (size_t d = 1; d < max_depth; ++d) {
+    printf("%6lu %12lu %12lu %14.1f\n", d, depth_decisions[d], depth_backtracks[d],
+           subtree_count[d] ? (double) subtree_total[d] / subtree_count[d] : 0.0);
+  }
+
+  sort(closed.begin(), closed.end(), [](const Subtree& x, const Subtree& y) { return x.decisions > y.decisions; });
+  printf("\nlargest subtrees:\n%6s %16s %12s %12s\n", "depth", "decision", "decisions", "ms");
+  for (size_t i = 0; i < closed.size() && i < k; ++i) {
+    char d[32];
+    snprintf(d, sizeof(d), "%lu -> %lu", closed[i].u, closed[i].v);
+    printf("%6lu %16s %12lu %12.3f\n", closed[i].depth, d, closed[i].decisions, closed[i].ms);
+  }
+
+  printf("\nmost blamed elements:\n%10s %12s\n", "element", "blames");
+  vector<pair<size_t, size_t>> elems = top(blamed, k);
+  for (size_t i = 0; i < elems.size(); ++i) {
+    printf("%10lu %12lu\n", elems[i].second, elems[i].first);
+  }
+  printf("\nmost blamed decisions:\n%16s %12s\n", "decision", "blames");
+  vector<pair<size_t, pair<size_t, size_t>>> pairs = top(blamed_pairs, k);
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    char d[32];
+    snprintf(d, sizeof(d), "%lu -> %lu", pairs[i].second.first, pairs[i].second.second);
+    printf("%16s %12lu\n", d, pairs[i].first);
+  }
+  return 0;
+}